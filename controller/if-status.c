@@ -24,6 +24,8 @@
 #include "lib/hmapx.h"
 #include "lib/util.h"
 #include "timeval.h"
+#include "openvswitch/dynamic-string.h"
+#include "openvswitch/list.h"
 #include "openvswitch/vlog.h"
 #include "lib/vswitch-idl.h"
 #include "lib/ovn-sb-idl.h"
@@ -185,6 +187,12 @@ struct ovs_iface {
                              * be fully programmed in OVS.  Only used in state
                              * OIF_INSTALL_FLOWS.
                              */
+    struct ovs_list install_node; /* In 'if_status_mgr.install_flows'.  Only
+                                   * used in state OIF_INSTALL_FLOWS. */
+    long long int claim_time;  /* When the interface was last claimed, 0 once
+                                * it has been reported up. */
+    long long int flows_time;  /* When the flows of the interface were
+                                * installed in OVS, 0 if not yet. */
     uint16_t mtu;           /* Extracted from OVS interface.mtu field. */
     enum can_bind bind_type;/* CAN_BIND_AS_MAIN or CAN_BIND_AS_ADDITIONAL */
     bool is_vif;            /* Vifs, container or virtual ports */
@@ -192,6 +200,32 @@ struct ovs_iface {
 
 static uint64_t ifaces_usage;
 
+/* Stages of bringing up a claimed interface for which latencies are
+ * collected. */
+enum if_status_stage {
+    IF_STAGE_FLOWS,     /* Claimed until flows installed in OVS. */
+    IF_STAGE_UP,        /* Flows installed until marked up. */
+    IF_STAGE_TOTAL,     /* Claimed until marked up. */
+    IF_STAGE_MAX,
+};
+
+static const char *if_status_stage_names[] = {
+    [IF_STAGE_FLOWS] = "claim to flows installed",
+    [IF_STAGE_UP]    = "flows installed to up",
+    [IF_STAGE_TOTAL] = "claim to up",
+};
+
+/* Histogram of the latencies of a stage, bucket 'i' counts the latencies
+ * below 2^i ms, the last one all the others. */
+#define IF_STATUS_LATENCY_BUCKETS 16
+
+struct if_status_latency {
+    uint64_t n;
+    uint64_t total_ms;
+    uint64_t max_ms;
+    uint64_t buckets[IF_STATUS_LATENCY_BUCKETS];
+};
+
 /* State machine manager for all local OVS interfaces. */
 struct if_status_mgr {
     /* All local interfaces, mapping from 'iface-id' to 'struct ovs_iface'. */
@@ -203,6 +237,10 @@ struct if_status_mgr {
     /* All local interfaces, stored per state. */
     struct hmapx ifaces_per_state[OIF_MAX];
 
+    /* Interfaces in state OIF_INSTALL_FLOWS, ordered by 'install_seqno', so
+     * that acked seqnos only need to look at the interfaces they cover. */
+    struct ovs_list install_flows;
+
     /* Registered ofctrl seqno type for port_binding flow installation. */
     size_t iface_seq_type_pb_cfg;
 
@@ -210,6 +248,9 @@ struct if_status_mgr {
      * interfaces have been installed.
      */
     uint32_t iface_seqno;
+
+    /* Latencies of the interfaces going through the claim stages. */
+    struct if_status_latency latency[IF_STAGE_MAX];
 };
 
 static struct ovs_iface *
@@ -240,6 +281,7 @@ if_status_mgr_create(void)
     for (size_t i = 0; i < ARRAY_SIZE(mgr->ifaces_per_state); i++) {
         hmapx_init(&mgr->ifaces_per_state[i]);
     }
+    ovs_list_init(&mgr->install_flows);
     shash_init(&mgr->ifaces);
     shash_init(&mgr->ovn_uninstall_hash);
     return mgr;
@@ -263,6 +305,7 @@ if_status_mgr_clear(struct if_status_mgr *mgr)
     for (size_t i = 0; i < ARRAY_SIZE(mgr->ifaces_per_state); i++) {
         ovs_assert(hmapx_is_empty(&mgr->ifaces_per_state[i]));
     }
+    ovs_assert(ovs_list_is_empty(&mgr->install_flows));
 }
 
 void
@@ -588,6 +631,7 @@ if_status_mgr_update(struct if_status_mgr *mgr,
             if (iface->is_vif) {
                 ovs_iface_set_state(mgr, iface, OIF_INSTALL_FLOWS);
                 iface->install_seqno = mgr->iface_seqno + 1;
+                ovs_list_push_back(&mgr->install_flows, &iface->install_node);
                 new_ifaces = true;
             } else {
                 ovs_iface_set_state(mgr, iface, OIF_MARK_UP);
@@ -653,15 +697,18 @@ if_status_mgr_run(struct if_status_mgr *mgr,
 {
     struct ofctrl_acked_seqnos *acked_seqnos =
             ofctrl_acked_seqnos_get(mgr->iface_seq_type_pb_cfg);
-    struct hmapx_node *node;
+    struct ovs_iface *iface;
 
     /* Move interfaces from state OIF_INSTALL_FLOWS to OIF_MARK_UP if a
      * notification has been received aabout their flows being installed
-     * in OVS.
+     * in OVS.  Seqnos are acked in the order they were requested, so the
+     * walk stops at the first interface waiting for a later seqno.
      */
-    HMAPX_FOR_EACH_SAFE (node, &mgr->ifaces_per_state[OIF_INSTALL_FLOWS]) {
-        struct ovs_iface *iface = node->data;
-
+    LIST_FOR_EACH_SAFE (iface, install_node, &mgr->install_flows) {
+        if (hmap_is_empty(&acked_seqnos->acked) ||
+            iface->install_seqno > acked_seqnos->last_acked) {
+            break;
+        }
         if (!ofctrl_acked_seqnos_contains(acked_seqnos,
                                           iface->install_seqno)) {
             continue;
@@ -778,6 +825,9 @@ ovs_iface_destroy(struct if_status_mgr *mgr, struct ovs_iface *iface)
     VLOG_DBG("Interface %s destroy: state %s", iface->id,
              if_state_names[iface->state]);
     hmapx_find_and_delete(&mgr->ifaces_per_state[iface->state], iface);
+    if (iface->state == OIF_INSTALL_FLOWS) {
+        ovs_list_remove(&iface->install_node);
+    }
     struct shash_node *node = shash_find(&mgr->ifaces, iface->id);
     if (node) {
         shash_steal(&mgr->ifaces, node);
@@ -805,6 +855,50 @@ ovn_uninstall_hash_destroy(struct if_status_mgr *mgr, char *name)
     }
 }
 
+static void
+if_status_latency_add(struct if_status_mgr *mgr, enum if_status_stage stage,
+                      long long int start, long long int end)
+{
+    struct if_status_latency *latency = &mgr->latency[stage];
+    uint64_t ms = end > start ? end - start : 0;
+    size_t bucket = 0;
+
+    while (bucket < IF_STATUS_LATENCY_BUCKETS - 1 && ms >= (1ULL << bucket)) {
+        bucket++;
+    }
+
+    latency->n++;
+    latency->total_ms += ms;
+    latency->max_ms = MAX(latency->max_ms, ms);
+    latency->buckets[bucket]++;
+}
+
+/* Records the latencies of the claim stages completed by 'iface' moving
+ * to 'state'. */
+static void
+ovs_iface_track_latency(struct if_status_mgr *mgr, struct ovs_iface *iface,
+                        enum if_state state)
+{
+    long long int now = time_msec();
+
+    if (state == OIF_CLAIMED) {
+        iface->claim_time = now;
+        iface->flows_time = 0;
+    } else if (!iface->claim_time) {
+        return;
+    } else if (iface->state == OIF_INSTALL_FLOWS &&
+               (state == OIF_REM_OLD_OVN_INST || state == OIF_MARK_UP)) {
+        iface->flows_time = now;
+        if_status_latency_add(mgr, IF_STAGE_FLOWS, iface->claim_time, now);
+    } else if (state == OIF_INSTALLED) {
+        if (iface->flows_time) {
+            if_status_latency_add(mgr, IF_STAGE_UP, iface->flows_time, now);
+        }
+        if_status_latency_add(mgr, IF_STAGE_TOTAL, iface->claim_time, now);
+        iface->claim_time = 0;
+    }
+}
+
 static void
 ovs_iface_set_state(struct if_status_mgr *mgr, struct ovs_iface *iface,
                     enum if_state state)
@@ -813,7 +907,12 @@ ovs_iface_set_state(struct if_status_mgr *mgr, struct ovs_iface *iface,
              if_state_names[iface->state],
              if_state_names[state]);
 
+    ovs_iface_track_latency(mgr, iface, state);
+
     hmapx_find_and_delete(&mgr->ifaces_per_state[iface->state], iface);
+    if (iface->state == OIF_INSTALL_FLOWS) {
+        ovs_list_remove(&iface->install_node);
+    }
     iface->state = state;
     hmapx_add(&mgr->ifaces_per_state[iface->state], iface);
     iface->install_seqno = 0;
@@ -905,6 +1004,36 @@ if_status_mgr_get_memory_usage(struct if_status_mgr *mgr,
                    ROUND_UP(ifaces_state_usage, 1024) / 1024);
 }
 
+void
+if_status_mgr_dump_latency(const struct if_status_mgr *mgr,
+                           struct ds *output)
+{
+    for (size_t i = 0; i < IF_STAGE_MAX; i++) {
+        const struct if_status_latency *latency = &mgr->latency[i];
+
+        ds_put_format(output, "%s: count=%"PRIu64, if_status_stage_names[i],
+                      latency->n);
+        if (latency->n) {
+            ds_put_format(output, " avg_msec=%"PRIu64" max_msec=%"PRIu64,
+                          latency->total_ms / latency->n, latency->max_ms);
+        }
+        ds_put_char(output, '\n');
+
+        for (size_t j = 0; j < IF_STATUS_LATENCY_BUCKETS; j++) {
+            if (!latency->buckets[j]) {
+                continue;
+            }
+            if (j < IF_STATUS_LATENCY_BUCKETS - 1) {
+                ds_put_format(output, "  < %llu ms: %"PRIu64"\n",
+                              1ULL << j, latency->buckets[j]);
+            } else {
+                ds_put_format(output, "  >= %llu ms: %"PRIu64"\n",
+                              1ULL << (j - 1), latency->buckets[j]);
+            }
+        }
+    }
+}
+
 bool
 if_status_is_port_claimed(const struct if_status_mgr *mgr,
                           const char *iface_id)
@@ -22,6 +22,7 @@
 #include "binding.h"
 #include "lport.h"
 
+struct ds;
 struct if_status_mgr;
 struct simap;
 
@@ -52,6 +53,8 @@ void if_status_mgr_run(struct if_status_mgr *mgr, struct local_binding_data *,
                        bool sb_readonly, bool ovs_readonly);
 void if_status_mgr_get_memory_usage(struct if_status_mgr *mgr,
                                     struct simap *usage);
+void if_status_mgr_dump_latency(const struct if_status_mgr *mgr,
+                                struct ds *output);
 bool if_status_mgr_iface_is_present(struct if_status_mgr *mgr,
                                     const char *iface_id);
 bool if_status_handle_claims(struct if_status_mgr *mgr,
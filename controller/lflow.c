@@ -44,16 +44,23 @@ VLOG_DEFINE_THIS_MODULE(lflow);
 
 COVERAGE_DEFINE(lflow_run);
 COVERAGE_DEFINE(consider_logical_flow);
+COVERAGE_DEFINE(lflow_actions_encode_cache_hit);
 
 /* Symbol table. */
 
 /* Contains "struct expr_symbol"s for fields supported by OVN lflows. */
 static struct shash symtab;
 
+/* Encodings of actions shared by many logical flows and datapaths.  Flushed
+ * on every full recompute, which also covers OVS feature changes. */
+#define LFLOW_ENCODE_CACHE_MAX_ENTRIES 65536
+static struct ovnacts_encode_cache encode_cache;
+
 void
 lflow_init(void)
 {
     ovn_init_symtab(&symtab);
+    ovnacts_encode_cache_init(&encode_cache, LFLOW_ENCODE_CACHE_MAX_ENTRIES);
 }
 
 struct lookup_port_aux {
@@ -89,8 +96,8 @@ add_matches_to_flow_table(const struct sbrec_logical_flow *,
                           const struct local_datapath *,
                           struct hmap *matches, uint8_t ptable,
                           uint8_t output_ptable, struct ofpbuf *ovnacts,
-                          bool ingress, struct lflow_ctx_in *,
-                          struct lflow_ctx_out *);
+                          bool cache_actions, bool ingress,
+                          struct lflow_ctx_in *, struct lflow_ctx_out *);
 static void
 consider_logical_flow(const struct sbrec_logical_flow *lflow,
                       bool is_recompute,
@@ -541,7 +548,8 @@ consider_lflow_for_added_as_ips__(
         expr_matches_prepare(&matches, start_conj_id - 1);
     }
     add_matches_to_flow_table(lflow, ldp, &matches, ptable, output_ptable,
-                              &ovnacts, ingress, l_ctx_in, l_ctx_out);
+                              &ovnacts, sset_is_empty(&template_vars_ref),
+                              ingress, l_ctx_in, l_ctx_out);
 done:
     expr_destroy(prereqs);
     ovnacts_free(ovnacts.data, ovnacts.size);
@@ -832,12 +840,17 @@ get_common_nat_zone(const struct local_datapath *ldp)
     }
 }
 
+/* Adds the OpenFlow flows for 'matches' with 'ovnacts' as their actions.  If
+ * 'cache_actions' is true, 'ovnacts' were parsed from 'lflow->actions' as is,
+ * without template variable expansion, so their encoding can be shared with
+ * other logical flows that have the same actions. */
 static void
 add_matches_to_flow_table(const struct sbrec_logical_flow *lflow,
                           const struct local_datapath *ldp,
                           struct hmap *matches, uint8_t ptable,
                           uint8_t output_ptable, struct ofpbuf *ovnacts,
-                          bool ingress, struct lflow_ctx_in *l_ctx_in,
+                          bool cache_actions, bool ingress,
+                          struct lflow_ctx_in *l_ctx_in,
                           struct lflow_ctx_out *l_ctx_out)
 {
     struct lookup_port_aux aux = {
@@ -889,7 +902,13 @@ add_matches_to_flow_table(const struct sbrec_logical_flow *lflow,
         .ctrl_meter_id = ctrl_meter_id,
         .common_nat_ct_zone = get_common_nat_zone(ldp),
     };
-    ovnacts_encode(ovnacts->data, ovnacts->size, &ep, &ofpacts);
+    if (!cache_actions) {
+        ovnacts_encode(ovnacts->data, ovnacts->size, &ep, &ofpacts);
+    } else if (ovnacts_encode_cached(&encode_cache, lflow->actions,
+                                     lflow->table_id, ovnacts->data,
+                                     ovnacts->size, &ep, &ofpacts)) {
+        COVERAGE_INC(lflow_actions_encode_cache_hit);
+    }
 
     struct expr_match *m;
     HMAP_FOR_EACH (m, hmap_node, matches) {
@@ -1204,7 +1223,8 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
     }
 
     add_matches_to_flow_table(lflow, ldp, matches, ptable, output_ptable,
-                              &ovnacts, ingress, l_ctx_in, l_ctx_out);
+                              &ovnacts, sset_is_empty(&template_vars_ref),
+                              ingress, l_ctx_in, l_ctx_out);
 
     /* Update cache if needed. */
     switch (lcv_type) {
@@ -2125,6 +2145,7 @@ lflow_run(struct lflow_ctx_in *l_ctx_in, struct lflow_ctx_out *l_ctx_out)
 {
     COVERAGE_INC(lflow_run);
 
+    ovnacts_encode_cache_clear(&encode_cache);
     add_logical_flows(l_ctx_in, l_ctx_out);
     add_neighbor_flows(l_ctx_in->sbrec_port_binding_by_name,
                        l_ctx_in->mac_binding_table,
@@ -2164,6 +2185,7 @@ lflow_destroy(void)
 {
     expr_symtab_destroy(&symtab);
     shash_destroy(&symtab);
+    ovnacts_encode_cache_destroy(&encode_cache);
 }
 
 bool
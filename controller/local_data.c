@@ -19,6 +19,7 @@
 #include "include/openvswitch/json.h"
 #include "lib/hmapx.h"
 #include "lib/flow.h"
+#include "lib/hash.h"
 #include "lib/util.h"
 #include "lib/vswitch-idl.h"
 #include "openvswitch/vlog.h"
@@ -46,6 +47,16 @@ static void local_datapath_peer_port_add(
     struct local_datapath *, const struct sbrec_port_binding *local,
     const struct sbrec_port_binding *remote);
 
+/* Node in 'local_datapath.peer_ports_index'. */
+struct peer_port_index_node {
+    struct hmap_node hmap_node;
+    const struct sbrec_port_binding *local;
+    size_t idx;                 /* Index in 'local_datapath.peer_ports'. */
+};
+
+static struct peer_port_index_node *local_datapath_peer_port_find(
+    const struct local_datapath *, const struct sbrec_port_binding *local);
+
 static struct tracked_datapath *tracked_datapath_create(
     const struct sbrec_datapath_binding *dp,
     enum en_tracked_resource_type tracked_type,
@@ -88,6 +99,7 @@ local_datapath_alloc(const struct sbrec_datapath_binding *dp)
     ld->is_transit_switch = datapath_is_transit_switch(dp);
     shash_init(&ld->external_ports);
     shash_init(&ld->multichassis_ports);
+    hmap_init(&ld->peer_ports_index);
     /* memory accounting - common part. */
     local_datapath_usage += sizeof *ld;
 
@@ -124,6 +136,13 @@ local_datapath_destroy(struct local_datapath *ld)
     local_datapath_usage -=
         ld->n_allocated_peer_ports * sizeof *ld->peer_ports;
 
+    struct peer_port_index_node *index_node;
+    HMAP_FOR_EACH_POP (index_node, hmap_node, &ld->peer_ports_index) {
+        local_datapath_usage -= sizeof *index_node;
+        free(index_node);
+    }
+    hmap_destroy(&ld->peer_ports_index);
+
     free(ld->peer_ports);
     shash_destroy(&ld->external_ports);
     shash_destroy(&ld->multichassis_ports);
@@ -236,24 +255,28 @@ remove_local_datapath_peer_port(const struct sbrec_port_binding *pb,
                                 struct local_datapath *ld,
                                 struct hmap *local_datapaths)
 {
-    size_t i = 0;
-    for (i = 0; i < ld->n_peer_ports; i++) {
-        if (ld->peer_ports[i].local == pb) {
-            break;
-        }
-    }
-
-    if (i == ld->n_peer_ports) {
+    struct peer_port_index_node *index_node =
+        local_datapath_peer_port_find(ld, pb);
+    if (!index_node) {
         return;
     }
 
+    size_t i = index_node->idx;
     const struct sbrec_port_binding *peer = ld->peer_ports[i].remote;
 
+    hmap_remove(&ld->peer_ports_index, &index_node->hmap_node);
+    free(index_node);
+    local_datapath_usage -= sizeof *index_node;
+
     /* Possible improvement: We can shrink the allocated peer ports
      * if (ld->n_peer_ports < ld->n_allocated_peer_ports / 2).
      */
-    ld->peer_ports[i].local = ld->peer_ports[ld->n_peer_ports - 1].local;
-    ld->peer_ports[i].remote = ld->peer_ports[ld->n_peer_ports - 1].remote;
+    size_t last = ld->n_peer_ports - 1;
+    if (i != last) {
+        ld->peer_ports[i].local = ld->peer_ports[last].local;
+        ld->peer_ports[i].remote = ld->peer_ports[last].remote;
+        local_datapath_peer_port_find(ld, ld->peer_ports[i].local)->idx = i;
+    }
     ld->n_peer_ports--;
 
     struct local_datapath *peer_ld =
@@ -625,16 +648,36 @@ tracked_datapath_create(const struct sbrec_datapath_binding *dp,
     return t_dp;
 }
 
+static struct peer_port_index_node *
+local_datapath_peer_port_find(const struct local_datapath *ld,
+                              const struct sbrec_port_binding *local)
+{
+    struct peer_port_index_node *index_node;
+    HMAP_FOR_EACH_WITH_HASH (index_node, hmap_node, hash_pointer(local, 0),
+                             &ld->peer_ports_index) {
+        if (index_node->local == local) {
+            return index_node;
+        }
+    }
+    return NULL;
+}
+
 static void
 local_datapath_peer_port_add(struct local_datapath *ld,
                              const struct sbrec_port_binding *local,
                              const struct sbrec_port_binding *remote)
 {
-    for (size_t i = 0; i < ld->n_peer_ports; i++) {
-        if (ld->peer_ports[i].local == local) {
-            return;
-        }
+    if (local_datapath_peer_port_find(ld, local)) {
+        return;
     }
+
+    struct peer_port_index_node *index_node = xmalloc(sizeof *index_node);
+    index_node->local = local;
+    index_node->idx = ld->n_peer_ports;
+    hmap_insert(&ld->peer_ports_index, &index_node->hmap_node,
+                hash_pointer(local, 0));
+    local_datapath_usage += sizeof *index_node;
+
     ld->n_peer_ports++;
     if (ld->n_peer_ports > ld->n_allocated_peer_ports) {
         size_t old_n_ports = ld->n_allocated_peer_ports;
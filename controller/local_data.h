@@ -60,6 +60,10 @@ struct local_datapath {
 
     size_t n_peer_ports;
     size_t n_allocated_peer_ports;
+    /* Position of each port in 'peer_ports', hashed by its 'local' port, so
+     * that routers with many peers don't need a linear search to add or
+     * remove one. */
+    struct hmap peer_ports_index;
 
     struct shash external_ports;
     struct shash multichassis_ports;
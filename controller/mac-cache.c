@@ -16,6 +16,7 @@
 #include <config.h>
 #include <stdbool.h>
 
+#include "coverage.h"
 #include "local_data.h"
 #include "lport.h"
 #include "mac-cache.h"
@@ -23,13 +24,19 @@
 #include "openvswitch/vlog.h"
 #include "ovn/logical-fields.h"
 #include "ovn-sb-idl.h"
+#include "simap.h"
 
 VLOG_DEFINE_THIS_MODULE(mac_cache);
 
+COVERAGE_DEFINE(mac_cache_drop_buffered_packet);
+
 #define MAX_BUFFERED_PACKETS        1000
 #define BUFFER_QUEUE_DEPTH          4
 #define BUFFERED_PACKETS_TIMEOUT_MS 10000
 #define BUFFERED_PACKETS_LOOKUP_MS  100
+/* Upper bound on the memory taken by all the buffered packets together,
+ * the packets of the least recently used destination are dropped first. */
+#define BUFFERED_PACKETS_MAX_BYTES  (4 * 1024 * 1024)
 
 static uint32_t
 mac_binding_data_hash(const struct mac_binding_data *mb_data);
@@ -46,7 +53,8 @@ static void
 mac_cache_threshold_remove(struct hmap *thresholds,
                            struct mac_cache_threshold *threshold);
 static void
-mac_cache_update_req_delay(struct hmap *thresholds, uint64_t *req_delay);
+mac_cache_update_req_delay(struct hmap *thresholds, uint64_t *req_delay,
+                           uint64_t *max_idle_age);
 
 static struct buffered_packets *
 buffered_packets_find(struct buffered_packets_ctx *ctx,
@@ -56,6 +64,10 @@ static void
 buffered_packets_remove(struct buffered_packets_ctx *ctx,
                         struct buffered_packets *bp);
 
+static void
+buffered_packets_drop_oldest(struct buffered_packets_ctx *ctx,
+                             struct buffered_packets *bp);
+
 static void
 buffered_packets_db_lookup(struct buffered_packets *bp,
                            struct ds *ip, struct eth_addr *mac,
@@ -361,7 +373,7 @@ mac_binding_stats_process_flow_stats(struct ovs_list *stats_list,
 
 void
 mac_binding_stats_run(struct ovs_list *stats_list, uint64_t *req_delay,
-                      void *data)
+                      uint64_t *max_idle_age, void *data)
 {
     struct mac_cache_data *cache_data = data;
     long long timewall_now = time_wall_msec();
@@ -390,7 +402,8 @@ mac_binding_stats_run(struct ovs_list *stats_list, uint64_t *req_delay,
         free(stats);
     }
 
-    mac_cache_update_req_delay(&cache_data->thresholds, req_delay);
+    mac_cache_update_req_delay(&cache_data->thresholds, req_delay,
+                               max_idle_age);
 }
 
 /* FDB stat processing. */
@@ -412,7 +425,7 @@ fdb_stats_process_flow_stats(struct ovs_list *stats_list,
 
 void
 fdb_stats_run(struct ovs_list *stats_list, uint64_t *req_delay,
-              void *data)
+              uint64_t *max_idle_age, void *data)
 {
     struct mac_cache_data *cache_data = data;
     long long timewall_now = time_wall_msec();
@@ -441,7 +454,8 @@ fdb_stats_run(struct ovs_list *stats_list, uint64_t *req_delay,
         free(stats);
     }
 
-    mac_cache_update_req_delay(&cache_data->thresholds, req_delay);
+    mac_cache_update_req_delay(&cache_data->thresholds, req_delay,
+                               max_idle_age);
 }
 
 /* Packet buffering. */
@@ -475,6 +489,13 @@ bp_packet_data_destroy(struct bp_packet_data *pd) {
     free(pd);
 }
 
+static size_t
+bp_packet_data_size(const struct bp_packet_data *pd)
+{
+    return sizeof *pd + pd->pin.packet_len +
+           sizeof *pd->continuation + pd->continuation->allocated;
+}
+
 struct buffered_packets *
 buffered_packets_add(struct buffered_packets_ctx *ctx,
                      struct mac_binding_data mb_data) {
@@ -492,7 +513,9 @@ buffered_packets_add(struct buffered_packets_ctx *ctx,
         /* Schedule the freshly added buffered packet to do lookup
          * immediately. */
         bp->lookup_at_ms = 0;
+        bp->lookup_delay_ms = BUFFERED_PACKETS_LOOKUP_MS;
         ovs_list_init(&bp->queue);
+        ovs_list_push_back(&ctx->lru, &bp->lru_node);
     }
 
     bp->expire_at_ms = time_msec() + BUFFERED_PACKETS_TIMEOUT_MS;
@@ -501,15 +524,34 @@ buffered_packets_add(struct buffered_packets_ctx *ctx,
 }
 
 void
-buffered_packets_packet_data_enqueue(struct buffered_packets *bp,
+buffered_packets_packet_data_enqueue(struct buffered_packets_ctx *ctx,
+                                     struct buffered_packets *bp,
                                      struct bp_packet_data *pd) {
     if (ovs_list_size(&bp->queue) == BUFFER_QUEUE_DEPTH) {
-        struct bp_packet_data *p = CONTAINER_OF(ovs_list_pop_front(&bp->queue),
-                                                struct bp_packet_data, node);
-
-        bp_packet_data_destroy(p);
+        buffered_packets_drop_oldest(ctx, bp);
     }
     ovs_list_push_back(&bp->queue, &pd->node);
+    ctx->n_bytes += bp_packet_data_size(pd);
+
+    ovs_list_remove(&bp->lru_node);
+    ovs_list_push_back(&ctx->lru, &bp->lru_node);
+
+    /* Stay within the memory budget by dropping the oldest packets of the
+     * least recently used destinations, this keeps the destinations that
+     * are still being sent to when e.g. a whole subnet gets scanned. */
+    while (ctx->n_bytes > BUFFERED_PACKETS_MAX_BYTES) {
+        struct buffered_packets *lru =
+            CONTAINER_OF(ovs_list_front(&ctx->lru),
+                         struct buffered_packets, lru_node);
+        if (lru == bp && ovs_list_is_short(&bp->queue)) {
+            break;
+        }
+
+        buffered_packets_drop_oldest(ctx, lru);
+        if (ovs_list_is_empty(&lru->queue)) {
+            buffered_packets_remove(ctx, lru);
+        }
+    }
 }
 
 void
@@ -540,8 +582,13 @@ buffered_packets_ctx_run(struct buffered_packets_ctx *ctx,
                                        sbrec_dp_by_key, sbrec_pb_by_name,
                                        sbrec_mb_by_lport_ip);
             /* Schedule next lookup even if we found the MAC address,
-             * if the address was found this struct will be deleted anyway. */
-            bp->lookup_at_ms = now + BUFFERED_PACKETS_LOOKUP_MS;
+             * if the address was found this struct will be deleted anyway.
+             * New MAC bindings are picked up through 'recent_mbs', the
+             * full lookup only covers races with it, so back off for the
+             * destinations that don't resolve, e.g. during a scan. */
+            bp->lookup_at_ms = now + bp->lookup_delay_ms;
+            bp->lookup_delay_ms = MIN(2 * bp->lookup_delay_ms,
+                                      BUFFERED_PACKETS_TIMEOUT_MS);
         }
 
         if (eth_addr_is_zero(mac)) {
@@ -550,6 +597,8 @@ buffered_packets_ctx_run(struct buffered_packets_ctx *ctx,
 
         struct bp_packet_data *pd;
         LIST_FOR_EACH_POP (pd, node, &bp->queue) {
+            ctx->n_bytes -= bp_packet_data_size(pd);
+
             struct dp_packet packet;
             dp_packet_use_const(&packet, pd->pin.packet, pd->pin.packet_len);
 
@@ -579,6 +628,8 @@ void
 buffered_packets_ctx_init(struct buffered_packets_ctx *ctx) {
     hmap_init(&ctx->buffered_packets);
     ovs_list_init(&ctx->ready_packets_data);
+    ovs_list_init(&ctx->lru);
+    ctx->n_bytes = 0;
 }
 
 void
@@ -595,6 +646,16 @@ buffered_packets_ctx_destroy(struct buffered_packets_ctx *ctx) {
     hmap_destroy(&ctx->buffered_packets);
 }
 
+void
+buffered_packets_ctx_get_memory_usage(const struct buffered_packets_ctx *ctx,
+                                      struct simap *usage)
+{
+    simap_increase(usage, "buffered_packets",
+                   hmap_count(&ctx->buffered_packets));
+    simap_increase(usage, "buffered_packets_usage-KB",
+                   ROUND_UP(ctx->n_bytes, 1024) / 1024);
+}
+
 
 void
 mac_cache_stats_destroy(struct ovs_list *stats_list)
@@ -670,17 +731,24 @@ mac_cache_threshold_remove(struct hmap *thresholds,
     free(threshold);
 }
 
+/* Updates the statistics request delay to the shortest dump period and
+ * 'max_idle_age' to the highest threshold, any flow idle for longer than
+ * that is aging out on every datapath and its statistics are not needed. */
 static void
-mac_cache_update_req_delay(struct hmap *thresholds, uint64_t *req_delay)
+mac_cache_update_req_delay(struct hmap *thresholds, uint64_t *req_delay,
+                           uint64_t *max_idle_age)
 {
     struct mac_cache_threshold *threshold;
 
     uint64_t dump_period = UINT64_MAX;
+    uint64_t value = 0;
     HMAP_FOR_EACH (threshold, hmap_node, thresholds) {
         dump_period = MIN(dump_period, threshold->dump_period);
+        value = MAX(value, threshold->value);
     }
 
     *req_delay = dump_period < UINT64_MAX ? dump_period : 0;
+    *max_idle_age = value ? value : UINT64_MAX;
 }
 
 static struct buffered_packets *
@@ -703,13 +771,27 @@ buffered_packets_remove(struct buffered_packets_ctx *ctx,
                         struct buffered_packets *bp) {
     struct bp_packet_data *pd;
     LIST_FOR_EACH_POP (pd, node, &bp->queue) {
+        ctx->n_bytes -= bp_packet_data_size(pd);
         bp_packet_data_destroy(pd);
     }
 
     hmap_remove(&ctx->buffered_packets, &bp->hmap_node);
+    ovs_list_remove(&bp->lru_node);
     free(bp);
 }
 
+static void
+buffered_packets_drop_oldest(struct buffered_packets_ctx *ctx,
+                             struct buffered_packets *bp)
+{
+    struct bp_packet_data *pd = CONTAINER_OF(ovs_list_pop_front(&bp->queue),
+                                             struct bp_packet_data, node);
+
+    ctx->n_bytes -= bp_packet_data_size(pd);
+    bp_packet_data_destroy(pd);
+    COVERAGE_INC(mac_cache_drop_buffered_packet);
+}
+
 static void
 buffered_packets_db_lookup(struct buffered_packets *bp, struct ds *ip,
                            struct eth_addr *mac,
@@ -28,6 +28,7 @@
 #include "ovn-sb-idl.h"
 
 struct ovsdb_idl_index;
+struct simap;
 
 struct mac_cache_data {
     /* 'struct mac_cache_threshold' by datapath's tunnel_key. */
@@ -106,6 +107,13 @@ struct buffered_packets {
 
     /* Timestamp in ms when the buffered packet should do full SB lookup.*/
     long long int lookup_at_ms;
+
+    /* Delay in ms before the next full SB lookup, doubled after every
+     * unsuccessful one. */
+    long long int lookup_delay_ms;
+
+    /* In 'buffered_packets_ctx.lru'. */
+    struct ovs_list lru_node;
 };
 
 struct buffered_packets_ctx {
@@ -113,6 +121,11 @@ struct buffered_packets_ctx {
     struct hmap buffered_packets;
     /* List of packet data that are ready to be sent. */
     struct ovs_list ready_packets_data;
+    /* 'struct buffered_packets' from the least to the most recently
+     * enqueued to. */
+    struct ovs_list lru;
+    /* Memory taken by the packet data in 'buffered_packets', in bytes. */
+    size_t n_bytes;
 };
 
 /* Thresholds. */
@@ -169,14 +182,14 @@ mac_binding_stats_process_flow_stats(struct ovs_list *stats_list,
                                      struct ofputil_flow_stats *ofp_stats);
 
 void mac_binding_stats_run(struct ovs_list *stats_list, uint64_t *req_delay,
-                           void *data);
+                           uint64_t *max_idle_age, void *data);
 
 /* FDB stat processing. */
 void fdb_stats_process_flow_stats(struct ovs_list *stats_list,
                                   struct ofputil_flow_stats *ofp_stats);
 
 void fdb_stats_run(struct ovs_list *stats_list, uint64_t *req_delay,
-                   void *data);
+                   uint64_t *max_idle_age, void *data);
 
 void mac_cache_stats_destroy(struct ovs_list *stats_list);
 
@@ -191,7 +204,8 @@ struct buffered_packets *
 buffered_packets_add(struct buffered_packets_ctx *ctx,
                      struct mac_binding_data mb_data);
 
-void buffered_packets_packet_data_enqueue(struct buffered_packets *bp,
+void buffered_packets_packet_data_enqueue(struct buffered_packets_ctx *ctx,
+                                          struct buffered_packets *bp,
                                           struct bp_packet_data *pd);
 
 void buffered_packets_ctx_run(struct buffered_packets_ctx *ctx,
@@ -209,4 +223,7 @@ bool buffered_packets_ctx_is_ready_to_send(struct buffered_packets_ctx *ctx);
 
 bool buffered_packets_ctx_has_packets(struct buffered_packets_ctx *ctx);
 
+void buffered_packets_ctx_get_memory_usage(
+    const struct buffered_packets_ctx *ctx, struct simap *usage);
+
 #endif /* controller/mac-cache.h */
@@ -29,6 +29,7 @@
 #include "chassis.h"
 #include "command-line.h"
 #include "compiler.h"
+#include "coverage.h"
 #include "daemon.h"
 #include "dirs.h"
 #include "openvswitch/dynamic-string.h"
@@ -72,6 +73,7 @@
 #include "simap.h"
 #include "smap.h"
 #include "sset.h"
+#include "svec.h"
 #include "stream-ssl.h"
 #include "stream.h"
 #include "unixctl.h"
@@ -90,6 +92,9 @@
 
 VLOG_DEFINE_THIS_MODULE(main);
 
+COVERAGE_DEFINE(sb_monitor_cond_change);
+COVERAGE_DEFINE(sb_monitor_cond_clauses);
+
 static unixctl_cb_func ct_zone_list;
 static unixctl_cb_func extend_table_list;
 static unixctl_cb_func inject_pkt;
@@ -101,8 +106,10 @@ static unixctl_cb_func debug_status_execution;
 static unixctl_cb_func debug_dump_local_bindings;
 static unixctl_cb_func debug_dump_local_template_vars;
 static unixctl_cb_func debug_dump_lflow_conj_ids;
+static unixctl_cb_func debug_dump_if_status_latency;
 static unixctl_cb_func lflow_cache_flush_cmd;
 static unixctl_cb_func lflow_cache_show_stats_cmd;
+static unixctl_cb_func pinctrl_show_stats_cmd;
 static unixctl_cb_func debug_delay_nb_cfg_report;
 static unixctl_cb_func debug_ignore_startup_delay;
 
@@ -381,6 +388,41 @@ out:;
         expected_cond_seqno = MAX(expected_cond_seqno, cond_seqnos[i]);
     }
 
+    /* The IDL only requests a new condition from the server when it differs
+     * from the last requested one and keeps a single request in flight, so
+     * bursts of changes are already coalesced.  Account for the requests
+     * that do go out and for their size, i.e., the clauses of the tables
+     * whose condition changed, which the server has to re-evaluate.
+     *
+     * A table's returned seqno also moves when the server acknowledges
+     * another table's change, so only consider the tables that still wait
+     * for an acknowledgement of their own. */
+    const struct ovsdb_idl_condition *conds[] = {
+        &pb, &lf, &ldpg, &mb, &fdb, &mg, &dns, &ce, &ip_mcast, &igmp,
+        &chprv, &tv,
+    };
+    BUILD_ASSERT_DECL(ARRAY_SIZE(conds) == ARRAY_SIZE(cond_seqnos));
+    static unsigned int last_cond_seqnos[ARRAY_SIZE(cond_seqnos)];
+    unsigned int acked_cond_seqno = ovsdb_idl_get_condition_seqno(ovnsb_idl);
+    size_t n_tables = 0;
+    size_t n_clauses = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(cond_seqnos); i++) {
+        if (cond_seqnos[i] != last_cond_seqnos[i]
+            && cond_seqnos[i] > acked_cond_seqno) {
+            n_tables++;
+            n_clauses += hmap_count(&conds[i]->clauses);
+        }
+        last_cond_seqnos[i] = cond_seqnos[i];
+    }
+
+    if (n_tables) {
+        COVERAGE_INC(sb_monitor_cond_change);
+        COVERAGE_ADD(sb_monitor_cond_clauses, n_clauses);
+        VLOG_DBG("Requested SB monitor condition change %u for %"PRIuSIZE
+                 " tables with %"PRIuSIZE" clauses.", expected_cond_seqno,
+                 n_tables, n_clauses);
+    }
+
     ovsdb_idl_condition_destroy(&pb);
     ovsdb_idl_condition_destroy(&lf);
     ovsdb_idl_condition_destroy(&ldpg);
@@ -1775,8 +1817,62 @@ en_template_vars_cleanup(void *data)
     sset_destroy(&tv_data->updated);
 }
 
+static void
+addr_set_addresses_get(const struct sbrec_address_set *as,
+                       struct svec *addresses)
+{
+    svec_init(addresses);
+    for (size_t i = 0; i < as->n_addresses; i++) {
+        svec_add(addresses, as->addresses[i]);
+    }
+    /* The IDL normally provides the addresses sorted already. */
+    if (!svec_is_sorted(addresses)) {
+        svec_sort(addresses);
+    }
+}
+
+static void
+addr_set_addresses_add(struct shash *addresses,
+                       const struct sbrec_address_set *as)
+{
+    struct svec *svec = xmalloc(sizeof *svec);
+    addr_set_addresses_get(as, svec);
+    shash_add(addresses, as->name, svec);
+}
+
+static void
+addr_set_addresses_remove(struct shash *addresses, const char *name)
+{
+    struct svec *svec = shash_find_and_delete(addresses, name);
+    if (svec) {
+        svec_destroy(svec);
+        free(svec);
+    }
+}
+
+static void
+addr_set_addresses_destroy(struct shash *addresses)
+{
+    struct shash_node *node;
+    SHASH_FOR_EACH_SAFE (node, addresses) {
+        struct svec *svec = node->data;
+        shash_delete(addresses, node);
+        svec_destroy(svec);
+        free(svec);
+    }
+}
+
 struct ed_type_addr_sets {
     struct shash addr_sets;
+    /* A sorted copy of the SB addresses of each address set, as "struct
+     * svec"s, so that updates only need to convert the changed ones. */
+    struct shash addresses;
+
+    /* If true, 'addr_sets' holds the address sets aggregated into CIDR
+     * prefixes, and 'raw_addr_sets' holds them as listed in the SB. */
+    bool aggregate;
+    struct shash raw_addr_sets;
+
     bool change_tracked;
     struct sset new;
     struct sset deleted;
@@ -1790,6 +1886,8 @@ en_addr_sets_init(struct engine_node *node OVS_UNUSED,
     struct ed_type_addr_sets *as = xzalloc(sizeof *as);
 
     shash_init(&as->addr_sets);
+    shash_init(&as->addresses);
+    shash_init(&as->raw_addr_sets);
     as->change_tracked = false;
     sset_init(&as->new);
     sset_init(&as->deleted);
@@ -1823,66 +1921,121 @@ en_addr_sets_cleanup(void *data)
     struct ed_type_addr_sets *as = data;
     expr_const_sets_destroy(&as->addr_sets);
     shash_destroy(&as->addr_sets);
+    addr_set_addresses_destroy(&as->addresses);
+    shash_destroy(&as->addresses);
+    expr_const_sets_destroy(&as->raw_addr_sets);
+    shash_destroy(&as->raw_addr_sets);
     sset_destroy(&as->new);
     sset_destroy(&as->deleted);
     shash_destroy(&as->updated);
 }
 
+static void
+addr_sets_add(struct ed_type_addr_sets *as_data,
+              const struct sbrec_address_set *as)
+{
+    struct expr_constant_set *cs = expr_constant_set_create_integers(
+        (const char *const *) as->addresses, as->n_addresses);
+    if (as_data->aggregate) {
+        expr_const_sets_add(&as_data->addr_sets, as->name,
+                            expr_constant_set_aggregate_cidrs(cs));
+        expr_const_sets_add(&as_data->raw_addr_sets, as->name, cs);
+    } else {
+        expr_const_sets_add(&as_data->addr_sets, as->name, cs);
+    }
+
+    addr_set_addresses_remove(&as_data->addresses, as->name);
+    addr_set_addresses_add(&as_data->addresses, as);
+}
+
 /* Iterate address sets in the southbound database.  Create and update the
  * corresponding symtab entries as necessary. */
 static void
 addr_sets_init(const struct sbrec_address_set_table *address_set_table,
-               struct shash *addr_sets)
+               struct ed_type_addr_sets *as_data)
 {
     const struct sbrec_address_set *as;
     SBREC_ADDRESS_SET_TABLE_FOR_EACH (as, address_set_table) {
-        expr_const_sets_add_integers(addr_sets, as->name,
-                                     (const char *const *) as->addresses,
-                                     as->n_addresses);
+        addr_sets_add(as_data, as);
     }
 }
 
 static void
 addr_sets_update(const struct sbrec_address_set_table *address_set_table,
-                 struct shash *addr_sets, struct sset *added,
-                 struct sset *deleted, struct shash *updated)
+                 struct ed_type_addr_sets *as_data)
 {
+    struct shash *addr_sets = &as_data->addr_sets;
+    struct shash *addresses = &as_data->addresses;
+    struct shash *raw_addr_sets = (as_data->aggregate
+                                   ? &as_data->raw_addr_sets
+                                   : &as_data->addr_sets);
+
     const struct sbrec_address_set *as;
     SBREC_ADDRESS_SET_TABLE_FOR_EACH_TRACKED (as, address_set_table) {
         if (sbrec_address_set_is_deleted(as)) {
             expr_const_sets_remove(addr_sets, as->name);
-            sset_add(deleted, as->name);
+            expr_const_sets_remove(&as_data->raw_addr_sets, as->name);
+            addr_set_addresses_remove(addresses, as->name);
+            sset_add(&as_data->deleted, as->name);
         }
     }
 
     SBREC_ADDRESS_SET_TABLE_FOR_EACH_TRACKED (as, address_set_table) {
         if (!sbrec_address_set_is_deleted(as)) {
-            struct expr_constant_set *cs_old = shash_find_data(addr_sets,
-                                                               as->name);
-            if (!cs_old) {
-                sset_add(added, as->name);
-                expr_const_sets_add_integers(addr_sets, as->name,
-                    (const char *const *) as->addresses, as->n_addresses);
+            struct expr_constant_set *cs = shash_find_data(raw_addr_sets,
+                                                           as->name);
+            struct svec *old_addresses = shash_find_data(addresses,
+                                                         as->name);
+            if (!cs || !old_addresses) {
+                sset_add(&as_data->new, as->name);
+                addr_sets_add(as_data, as);
             } else {
-                /* Find out the diff for the updated address set. */
-                struct expr_constant_set *cs_new =
-                    expr_constant_set_create_integers(
-                        (const char *const *) as->addresses, as->n_addresses);
+                /* Find out which addresses changed and apply only those to
+                 * the constant set. */
+                struct svec new_addresses;
+                addr_set_addresses_get(as, &new_addresses);
+
+                struct svec added_addresses, deleted_addresses;
+                svec_diff(&new_addresses, old_addresses, &added_addresses,
+                          NULL, &deleted_addresses);
+                svec_swap(&new_addresses, old_addresses);
+                svec_destroy(&new_addresses);
+
                 struct addr_set_diff *as_diff = xmalloc(sizeof *as_diff);
-                expr_constant_set_integers_diff(cs_old, cs_new,
-                                                &as_diff->added,
-                                                &as_diff->deleted);
+                expr_constant_set_integers_update(
+                    cs,
+                    (const char *const *) added_addresses.names,
+                    added_addresses.n,
+                    (const char *const *) deleted_addresses.names,
+                    deleted_addresses.n,
+                    &as_diff->added, &as_diff->deleted);
+                svec_destroy(&added_addresses);
+                svec_destroy(&deleted_addresses);
+
+                if (as_data->aggregate
+                    && (as_diff->added || as_diff->deleted)) {
+                    /* Report the change in terms of the aggregated prefixes,
+                     * which are what the logical flows were expanded from. */
+                    expr_constant_set_destroy(as_diff->added);
+                    free(as_diff->added);
+                    expr_constant_set_destroy(as_diff->deleted);
+                    free(as_diff->deleted);
+                    struct expr_constant_set *agg
+                        = expr_constant_set_aggregate_cidrs(cs);
+                    expr_constant_set_integers_diff(
+                        shash_find_data(addr_sets, as->name), agg,
+                        &as_diff->added, &as_diff->deleted);
+                    expr_const_sets_add(addr_sets, as->name, agg);
+                }
+
                 if (!as_diff->added && !as_diff->deleted) {
                     /* The address set may have been updated, but the change
                      * doesn't has any impact to the generated constant-set.
                      * For example, ff::01 is changed to ff::00:01. */
                     free(as_diff);
-                    expr_constant_set_destroy(cs_new);
-                    free(cs_new);
                     continue;
                 }
-                shash_add(updated, as->name, as_diff);
-                expr_const_sets_add(addr_sets, as->name, cs_new);
+                shash_add(&as_data->updated, as->name, as_diff);
             }
         }
     }
@@ -1894,12 +2047,21 @@ en_addr_sets_run(struct engine_node *node, void *data)
     struct ed_type_addr_sets *as = data;
 
     expr_const_sets_destroy(&as->addr_sets);
+    expr_const_sets_destroy(&as->raw_addr_sets);
+    addr_set_addresses_destroy(&as->addresses);
 
     struct sbrec_address_set_table *as_table =
         (struct sbrec_address_set_table *)EN_OVSDB_GET(
             engine_get_input("SB_address_set", node));
+    const struct ovsrec_open_vswitch_table *ovs_table =
+        EN_OVSDB_GET(engine_get_input("OVS_open_vswitch", node));
+    const struct ovsrec_open_vswitch *cfg =
+        ovsrec_open_vswitch_table_first(ovs_table);
 
-    addr_sets_init(as_table, &as->addr_sets);
+    as->aggregate = cfg && get_chassis_external_id_value_bool(
+        &cfg->external_ids, get_ovs_chassis_id(ovs_table),
+        "ovn-aggregate-address-sets", false);
+    addr_sets_init(as_table, as);
 
     as->change_tracked = false;
     engine_set_node_state(node, EN_UPDATED);
@@ -1914,8 +2076,7 @@ addr_sets_sb_address_set_handler(struct engine_node *node, void *data)
         (struct sbrec_address_set_table *)EN_OVSDB_GET(
             engine_get_input("SB_address_set", node));
 
-    addr_sets_update(as_table, &as->addr_sets, &as->new,
-                     &as->deleted, &as->updated);
+    addr_sets_update(as_table, as);
 
     if (!sset_is_empty(&as->new) || !sset_is_empty(&as->deleted) ||
             !shash_is_empty(&as->updated)) {
@@ -5043,6 +5204,7 @@ main(int argc, char *argv[])
 
     engine_add_input(&en_addr_sets, &en_sb_address_set,
                      addr_sets_sb_address_set_handler);
+    engine_add_input(&en_addr_sets, &en_ovs_open_vswitch, NULL);
     engine_add_input(&en_port_groups, &en_sb_port_group,
                      port_groups_sb_port_group_handler);
     /* port_groups computation requires runtime_data's lbinding_data for the
@@ -5299,6 +5461,8 @@ main(int argc, char *argv[])
     unixctl_command_register("lflow-cache/show-stats", "", 0, 0,
                              lflow_cache_show_stats_cmd,
                              &lflow_output_data->pd);
+    unixctl_command_register("pinctrl/show-stats", "", 0, 0,
+                             pinctrl_show_stats_cmd, NULL);
 
     bool reset_ovnsb_idl_min_index = false;
     unixctl_command_register("sb-cluster-state-reset", "", 0, 0,
@@ -5342,6 +5506,9 @@ main(int argc, char *argv[])
     };
     struct if_status_mgr *if_mgr = ctrl_engine_ctx.if_mgr;
 
+    unixctl_command_register("debug/dump-if-status-latency", "", 0, 0,
+                             debug_dump_if_status_latency, if_mgr);
+
     struct shash vif_plug_deleted_iface_ids =
         SHASH_INITIALIZER(&vif_plug_deleted_iface_ids);
     struct shash vif_plug_changed_iface_ids =
@@ -5361,6 +5528,7 @@ main(int argc, char *argv[])
             ofctrl_get_memory_usage(&usage);
             if_status_mgr_get_memory_usage(if_mgr, &usage);
             local_datapath_memory_usage(&usage);
+            pinctrl_get_memory_usage(&usage);
             ovsdb_idl_get_memory_usage(ovnsb_idl_loop.idl, &usage);
             ovsdb_idl_get_memory_usage(ovs_idl_loop.idl, &usage);
             memory_report(&usage);
@@ -6153,6 +6321,17 @@ lflow_cache_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
     ds_destroy(&ds);
 }
 
+static void
+pinctrl_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                       const char *argv[] OVS_UNUSED, void *arg OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    pinctrl_get_stats(&ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
 static void
 cluster_state_reset_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
                const char *argv[] OVS_UNUSED, void *idl_reset_)
@@ -6241,6 +6420,16 @@ debug_dump_lflow_conj_ids(struct unixctl_conn *conn, int argc OVS_UNUSED,
     ds_destroy(&conj_ids_dump);
 }
 
+static void
+debug_dump_if_status_latency(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                             const char *argv[] OVS_UNUSED, void *if_mgr)
+{
+    struct ds latency = DS_EMPTY_INITIALIZER;
+    if_status_mgr_dump_latency(if_mgr, &latency);
+    unixctl_command_reply(conn, ds_cstr(&latency));
+    ds_destroy(&latency);
+}
+
 static void
 debug_dump_local_template_vars(struct unixctl_conn *conn, int argc OVS_UNUSED,
                                const char *argv[] OVS_UNUSED, void *local_vars)
@@ -25,6 +25,7 @@
 #include "encaps.h"
 #include "flow.h"
 #include "ha-chassis.h"
+#include "heap.h"
 #include "local_data.h"
 #include "lport.h"
 #include "mac-cache.h"
@@ -187,6 +188,31 @@ struct pinctrl {
 
 static struct pinctrl pinctrl;
 
+/* Packet-in statistics.
+ *
+ * Updated by the pinctrl_handler thread for every packet-in it processes and
+ * read by the main thread through pinctrl_get_stats().  They are protected by
+ * their own mutex, so that neither side has to wait for 'pinctrl_mutex',
+ * which pinctrl_run() may hold for a long time. */
+#define PINCTRL_PIN_BATCH_SIZE 50
+#define PINCTRL_N_OPCODES (ACTION_OPCODE_DHCP_RELAY_RESP_CHK + 1)
+
+struct pinctrl_pin_stats {
+    uint64_t n_packets;     /* Number of packet-ins processed. */
+    uint64_t total_usec;    /* Total time spent processing them. */
+    uint64_t max_usec;      /* Longest time spent on a single packet-in. */
+};
+
+static struct ovs_mutex pinctrl_stats_mutex = OVS_MUTEX_INITIALIZER;
+static struct pinctrl_pin_stats pin_stats[PINCTRL_N_OPCODES]
+    OVS_GUARDED_BY(pinctrl_stats_mutex);
+/* Number of packet-ins received in each batch read from the OpenFlow
+ * connection.  A batch is full when PINCTRL_PIN_BATCH_SIZE packet-ins were
+ * read at once, i.e., more were waiting to be processed. */
+static uint64_t pin_n_batches OVS_GUARDED_BY(pinctrl_stats_mutex);
+static uint64_t pin_n_full_batches OVS_GUARDED_BY(pinctrl_stats_mutex);
+static size_t pin_last_batch_size OVS_GUARDED_BY(pinctrl_stats_mutex);
+
 static void init_buffered_packets_ctx(void);
 static void destroy_buffered_packets_ctx(void);
 static void
@@ -396,6 +422,8 @@ static void pinctrl_handle_put_fdb(const struct flow *md,
                                    OVS_REQUIRES(pinctrl_mutex);
 
 COVERAGE_DEFINE(pinctrl_drop_put_mac_binding);
+COVERAGE_DEFINE(pinctrl_coalesce_put_mac_binding);
+COVERAGE_DEFINE(pinctrl_skip_put_mac_binding);
 COVERAGE_DEFINE(pinctrl_drop_buffered_packets_map);
 COVERAGE_DEFINE(pinctrl_drop_controller_event);
 COVERAGE_DEFINE(pinctrl_drop_put_vport_binding);
@@ -1560,7 +1588,7 @@ OVS_REQUIRES(pinctrl_mutex)
     }
 
     struct bp_packet_data *pd = bp_packet_data_create(pin, continuation);
-    buffered_packets_packet_data_enqueue(bp, pd);
+    buffered_packets_packet_data_enqueue(&buffered_packets_ctx, bp, pd);
 
     /* There is a chance that the MAC binding was already created. */
     notify_pinctrl_main();
@@ -3738,6 +3766,8 @@ process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
         return;
     }
 
+    long long int start_usec = time_usec();
+
     struct dp_packet packet;
     dp_packet_use_const(&packet, pin.packet, pin.packet_len);
     struct flow headers;
@@ -3904,6 +3934,16 @@ process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
         break;
     }
 
+    uint32_t opcode = ntohl(ah->opcode);
+    if (opcode < PINCTRL_N_OPCODES) {
+        uint64_t usec = time_usec() - start_usec;
+
+        ovs_mutex_lock(&pinctrl_stats_mutex);
+        pin_stats[opcode].n_packets++;
+        pin_stats[opcode].total_usec += usec;
+        pin_stats[opcode].max_usec = MAX(pin_stats[opcode].max_usec, usec);
+        ovs_mutex_unlock(&pinctrl_stats_mutex);
+    }
 
     if (VLOG_IS_DBG_ENABLED()) {
         struct ds pin_str = DS_EMPTY_INITIALIZER;
@@ -4019,7 +4059,8 @@ pinctrl_handler(void *arg_)
                 conn_seq_no = rconn_get_connection_seqno(swconn);
             }
 
-            for (int i = 0; i < 50; i++) {
+            size_t n_pins = 0;
+            for (int i = 0; i < PINCTRL_PIN_BATCH_SIZE; i++) {
                 struct ofpbuf *msg = rconn_recv(swconn);
                 if (!msg) {
                     break;
@@ -4031,6 +4072,15 @@ pinctrl_handler(void *arg_)
                 ofptype_decode(&type, oh);
                 pinctrl_recv(swconn, oh, type);
                 ofpbuf_delete(msg);
+                n_pins += type == OFPTYPE_PACKET_IN;
+            }
+
+            if (n_pins) {
+                ovs_mutex_lock(&pinctrl_stats_mutex);
+                pin_n_batches++;
+                pin_n_full_batches += n_pins == PINCTRL_PIN_BATCH_SIZE;
+                pin_last_batch_size = n_pins;
+                ovs_mutex_unlock(&pinctrl_stats_mutex);
             }
 
             if (may_inject_pkts()) {
@@ -4069,6 +4119,39 @@ pinctrl_handler(void *arg_)
     return NULL;
 }
 
+/* Called with in the main ovn-controller thread context. */
+void
+pinctrl_get_stats(struct ds *output)
+{
+    ovs_mutex_lock(&pinctrl_stats_mutex);
+    ds_put_format(output, "Packet-in batches: %"PRIu64" (%"PRIu64" full, "
+                  "last: %"PRIuSIZE")\n", pin_n_batches, pin_n_full_batches,
+                  pin_last_batch_size);
+    for (uint32_t i = 0; i < PINCTRL_N_OPCODES; i++) {
+        const struct pinctrl_pin_stats *st = &pin_stats[i];
+
+        if (!st->n_packets) {
+            continue;
+        }
+
+        char *opcode = ovnact_op_to_string(i);
+        ds_put_format(output, "%-20s: packets=%"PRIu64" avg_usec=%"PRIu64
+                      " max_usec=%"PRIu64"\n", opcode, st->n_packets,
+                      st->total_usec / st->n_packets, st->max_usec);
+        free(opcode);
+    }
+    ovs_mutex_unlock(&pinctrl_stats_mutex);
+}
+
+/* Called with in the main ovn-controller thread context. */
+void
+pinctrl_get_memory_usage(struct simap *usage)
+{
+    ovs_mutex_lock(&pinctrl_mutex);
+    buffered_packets_ctx_get_memory_usage(&buffered_packets_ctx, usage);
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
 void
 pinctrl_update_swconn(const char *target, int probe_interval)
 {
@@ -4726,7 +4809,15 @@ pinctrl_destroy(void)
  * but in fact we can only update it when 'ovnsb_idl_txn' is nonnull.  Thus,
  * we buffer up a few put_mac_bindings (but we don't keep them longer
  * than 1 second) and apply them whenever a database transaction is
- * available. */
+ * available.
+ *
+ * Repeated requests for the same (datapath, port, IP) tuple that arrive
+ * while the first one is still buffered are coalesced into a single entry,
+ * keeping the earliest deadline, and an entry whose MAC already matches the
+ * Southbound row is dropped without touching the database.  Together with
+ * the random delay applied to multicast (G)ARPs this gives every chassis
+ * that learns the same neighbor a chance to observe the binding written by
+ * another one before issuing its own write. */
 
 /* Buffered "put_mac_binding" operation. */
 
@@ -4756,11 +4847,6 @@ pinctrl_handle_put_mac_binding(const struct flow *md,
                                bool is_arp)
     OVS_REQUIRES(pinctrl_mutex)
 {
-    if (hmap_count(&put_mac_bindings) >= MAX_MAC_BINDINGS) {
-        COVERAGE_INC(pinctrl_drop_put_mac_binding);
-        return;
-    }
-
     struct mac_binding_data mb_data = (struct mac_binding_data) {
             .dp_key =  ntohll(md->metadata),
             .port_key =  md->regs[MFF_LOG_INPORT - MFF_REG0],
@@ -4780,7 +4866,20 @@ pinctrl_handle_put_mac_binding(const struct flow *md,
                      ? random_range(MAX_MAC_BINDING_DELAY_MSEC) + 1
                      : 0;
     long long timestamp = time_msec() + delay;
-    mac_binding_add(&put_mac_bindings, mb_data, timestamp);
+
+    struct mac_binding *mb = mac_binding_find(&put_mac_bindings, &mb_data);
+    if (mb) {
+        /* Keep the earliest deadline so that a burst of (G)ARPs for the
+         * same neighbor doesn't keep postponing the update. */
+        COVERAGE_INC(pinctrl_coalesce_put_mac_binding);
+        mb->data.mac = mb_data.mac;
+        mb->timestamp = MIN(mb->timestamp, timestamp);
+    } else if (hmap_count(&put_mac_bindings) >= MAX_MAC_BINDINGS) {
+        COVERAGE_INC(pinctrl_drop_put_mac_binding);
+        return;
+    } else {
+        mac_binding_add(&put_mac_bindings, mb_data, timestamp);
+    }
 
     /* We can send the buffered packet once the main ovn-controller
      * thread calls pinctrl_run() and it writes the mac_bindings stored
@@ -4841,6 +4940,8 @@ mac_binding_add_to_sb(struct ovsdb_idl_txn *ovnsb_idl_txn,
         if (pinctrl.mac_binding_can_timestamp) {
             sbrec_mac_binding_set_timestamp(b, time_wall_msec());
         }
+    } else {
+        COVERAGE_INC(pinctrl_skip_put_mac_binding);
     }
 }
 
@@ -4904,11 +5005,6 @@ run_put_mac_binding(struct ovsdb_idl_txn *ovnsb_idl_txn,
         return;
     }
 
-    /* Convert ethernet argument to string form for database. */
-    char mac_string[ETH_ADDR_STRLEN + 1];
-    snprintf(mac_string, sizeof mac_string,
-             ETH_ADDR_FMT, ETH_ADDR_ARGS(mb->data.mac));
-
     struct ds ip_s = DS_EMPTY_INITIALIZER;
     ipv6_format_mapped(&mb->data.ip, &ip_s);
     mac_binding_add_to_sb(ovnsb_idl_txn, sbrec_mac_binding_by_lport_ip,
@@ -5011,9 +5107,13 @@ wait_put_mac_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn)
         return;
     }
 
+    long long int next_timestamp = LLONG_MAX;
     struct mac_binding *mb;
     HMAP_FOR_EACH (mb, hmap_node, &put_mac_bindings) {
-        poll_timer_wait_until(mb->timestamp);
+        next_timestamp = MIN(next_timestamp, mb->timestamp);
+    }
+    if (next_timestamp != LLONG_MAX) {
+        poll_timer_wait_until(next_timestamp);
     }
 }
 
@@ -5034,20 +5134,45 @@ struct garp_rarp_data {
                                   * announcement (in msecs). */
     uint32_t dp_key;             /* Datapath used to output this GARP. */
     uint32_t port_key;           /* Port to inject the GARP into. */
+    struct heap_node heap_node;  /* In 'send_garp_rarp_heap'. */
 };
 
 /* Contains GARPs/RARPs to be sent. Protected by pinctrl_mutex*/
 static struct shash send_garp_rarp_data;
 
+/* All the entries of 'send_garp_rarp_data', ordered by 'announce_time', so
+ * that the pinctrl_handler thread only has to look at the entries that are
+ * due instead of walking all of them on every wakeup.  The entry with the
+ * earliest 'announce_time' has the highest priority.
+ * Protected by pinctrl_mutex. */
+static struct heap send_garp_rarp_heap;
+
+static uint64_t
+garp_rarp_heap_priority(long long int announce_time)
+{
+    return LLONG_MAX - announce_time;
+}
+
+static void
+garp_rarp_set_announce_time(struct garp_rarp_data *garp_rarp,
+                            long long int announce_time)
+{
+    garp_rarp->announce_time = announce_time;
+    heap_change(&send_garp_rarp_heap, &garp_rarp->heap_node,
+                garp_rarp_heap_priority(announce_time));
+}
+
 static void
 init_send_garps_rarps(void)
 {
     shash_init(&send_garp_rarp_data);
+    heap_init(&send_garp_rarp_heap);
 }
 
 static void
 destroy_send_garps_rarps(void)
 {
+    heap_destroy(&send_garp_rarp_heap);
     shash_destroy_free_data(&send_garp_rarp_data);
 }
 
@@ -5064,6 +5189,8 @@ add_garp_rarp(const char *name, const struct eth_addr ea, ovs_be32 ip,
     garp_rarp->dp_key = dp_key;
     garp_rarp->port_key = port_key;
     shash_add(&send_garp_rarp_data, name, garp_rarp);
+    heap_insert(&send_garp_rarp_heap, &garp_rarp->heap_node,
+                garp_rarp_heap_priority(garp_rarp->announce_time));
 
     /* Notify pinctrl_handler so that it can wakeup and process
      * these GARP/RARP requests. */
@@ -5107,7 +5234,8 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
                     if (garp_max_timeout != garp_rarp_max_timeout ||
                         garp_continuous != garp_rarp_continuous) {
                         /* reset backoff */
-                        garp_rarp->announce_time = time_msec() + 1000;
+                        garp_rarp_set_announce_time(garp_rarp,
+                                                    time_msec() + 1000);
                         garp_rarp->backoff = 1000; /* msec. */
                     }
                 } else if (ovnsb_idl_txn) {
@@ -5137,7 +5265,8 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
                         if (garp_max_timeout != garp_rarp_max_timeout ||
                             garp_continuous != garp_rarp_continuous) {
                             /* reset backoff */
-                            garp_rarp->announce_time = time_msec() + 1000;
+                            garp_rarp_set_announce_time(garp_rarp,
+                                                        time_msec() + 1000);
                             garp_rarp->backoff = 1000; /* msec. */
                         }
                     } else {
@@ -5162,7 +5291,7 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
         if (garp_max_timeout != garp_rarp_max_timeout ||
             garp_continuous != garp_rarp_continuous) {
             /* reset backoff */
-            garp_rarp->announce_time = time_msec() + 1000;
+            garp_rarp_set_announce_time(garp_rarp, time_msec() + 1000);
             garp_rarp->backoff = 1000; /* msec. */
         }
         return;
@@ -5201,7 +5330,10 @@ send_garp_rarp_delete(const char *lport)
 {
     struct garp_rarp_data *garp_rarp = shash_find_and_delete
                                        (&send_garp_rarp_data, lport);
-    free(garp_rarp);
+    if (garp_rarp) {
+        heap_remove(&send_garp_rarp_heap, &garp_rarp->heap_node);
+        free(garp_rarp);
+    }
     notify_pinctrl_handler();
 }
 
@@ -5253,9 +5385,10 @@ send_garp_rarp(struct rconn *swconn, struct garp_rarp_data *garp_rarp,
      * vif if garp_rarp_max_timeout is not specified otherwise cap the max
      * timeout to garp_rarp_max_timeout. */
     if (garp_rarp_continuous || garp_rarp->backoff < garp_rarp_max_timeout) {
-        garp_rarp->announce_time = current_time + garp_rarp->backoff;
+        garp_rarp_set_announce_time(garp_rarp,
+                                    current_time + garp_rarp->backoff);
     } else {
-        garp_rarp->announce_time = LLONG_MAX;
+        garp_rarp_set_announce_time(garp_rarp, LLONG_MAX);
     }
     garp_rarp->backoff = MIN(garp_rarp_max_timeout, garp_rarp->backoff * 2);
 
@@ -6538,20 +6671,25 @@ static void
 send_garp_rarp_run(struct rconn *swconn, long long int *send_garp_rarp_time)
     OVS_REQUIRES(pinctrl_mutex)
 {
-    if (shash_is_empty(&send_garp_rarp_data)) {
+    if (heap_is_empty(&send_garp_rarp_heap)) {
         return;
     }
 
-    /* Send GARPs, and update the next announcement. */
-    struct shash_node *iter;
+    /* Send the GARPs that are due.  send_garp_rarp() moves each of them
+     * further down the heap, so this stops at the first entry that is not
+     * due yet, which is also the next announcement. */
     long long int current_time = time_msec();
-    *send_garp_rarp_time = LLONG_MAX;
-    SHASH_FOR_EACH (iter, &send_garp_rarp_data) {
-        long long int next_announce = send_garp_rarp(swconn, iter->data,
-                                                     current_time);
-        if (*send_garp_rarp_time > next_announce) {
-            *send_garp_rarp_time = next_announce;
+    for (;;) {
+        struct garp_rarp_data *garp_rarp =
+            CONTAINER_OF(heap_max(&send_garp_rarp_heap),
+                         struct garp_rarp_data, heap_node);
+        long long int announce_time = garp_rarp->announce_time;
+
+        if (announce_time > current_time) {
+            *send_garp_rarp_time = announce_time;
+            break;
         }
+        send_garp_rarp(swconn, garp_rarp, current_time);
     }
 }
 
@@ -8379,10 +8517,6 @@ svc_monitors_run(struct rconn *swconn,
     *svc_monitors_next_run_time = LLONG_MAX;
     struct svc_monitor *svc_mon;
     LIST_FOR_EACH (svc_mon, list_node, &svc_monitors) {
-        char ip_[INET6_ADDRSTRLEN + 1];
-        memset(ip_, 0, INET6_ADDRSTRLEN + 1);
-        ipv6_string_mapped(ip_, &svc_mon->ip);
-
         long long int current_time = time_msec();
         long long int next_run_time = LLONG_MAX;
         enum svc_monitor_status old_status = svc_mon->status;
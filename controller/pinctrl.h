@@ -23,8 +23,10 @@
 #include "openvswitch/list.h"
 #include "openvswitch/meta-flow.h"
 
+struct ds;
 struct hmap;
 struct shash;
+struct simap;
 struct lport_index;
 struct ovsdb_idl;
 struct ovsdb_idl_index;
@@ -66,6 +68,8 @@ void pinctrl_destroy(void);
 void pinctrl_update_swconn(const char *target, int probe_interval);
 
 void pinctrl_update(const struct ovsdb_idl *idl);
+void pinctrl_get_stats(struct ds *);
+void pinctrl_get_memory_usage(struct simap *usage);
 
 struct activated_port {
     uint32_t dp_key;
@@ -51,18 +51,25 @@ struct stats_node {
     int64_t next_request_timestamp;
     /* Request delay in ms. */
     uint64_t request_delay;
-    /* List of processed statistics. */
+    /* Replies for flows that have been idle for at least this long (in ms)
+     * are of no interest to the node and are dropped right away. */
+    uint64_t max_idle_age;
+    /* List of processed statistics.  The statctrl thread decodes the replies
+     * into a private list and only splices it in here, the main thread takes
+     * the whole list out the same way, so neither of them holds the mutex
+     * while walking the statistics. */
     struct ovs_list stats_list;
     /* Function to clean up the node.
      * This function runs in main thread. */
     void (*destroy)(struct ovs_list *stats_list);
     /* Function to process the response and store it in the list.
-     * This function runs in statctrl thread locked behind mutex. */
+     * This function runs in statctrl thread. */
     void (*process_flow_stats)(struct ovs_list *stats_list,
                                struct ofputil_flow_stats *ofp_stats);
     /* Function to process the parsed stats.
-     * This function runs in main thread locked behind mutex. */
-    void (*run)(struct ovs_list *stats_list, uint64_t *req_delay, void *data);
+     * This function runs in main thread. */
+    void (*run)(struct ovs_list *stats_list, uint64_t *req_delay,
+                uint64_t *max_idle_age, void *data);
 };
 
 #define STATS_NODE(NAME, REQUEST, DESTROY, PROCESS, RUN)                   \
@@ -71,6 +78,7 @@ struct stats_node {
         .xid = 0,                                                          \
         .next_request_timestamp = INT64_MAX,                               \
         .request_delay = 0,                                                \
+        .max_idle_age = UINT64_MAX,                                        \
         .stats_list =                                                      \
             OVS_LIST_INITIALIZER(                                          \
                 &statctrl_ctx.nodes[STATS_##NAME].stats_list),             \
@@ -102,12 +110,12 @@ static void statctrl_handle_rconn_msg(struct rconn *swconn,
 static enum stat_type statctrl_get_stat_type(struct statctrl_ctx *ctx,
                                              const struct ofp_header *oh);
 static void statctrl_decode_statistics_reply(struct stats_node *node,
-                                             struct ofpbuf *msg)
-    OVS_REQUIRES(mutex);
+                                             uint64_t max_idle_age,
+                                             struct ovs_list *stats_list,
+                                             struct ofpbuf *msg);
 static void statctrl_send_request(struct rconn *swconn,
                                   struct statctrl_ctx *ctx)
     OVS_REQUIRES(mutex);
-static void statctrl_notify_main_thread(struct statctrl_ctx *ctx);
 static void statctrl_wait_next_request(struct statctrl_ctx *ctx)
     OVS_REQUIRES(mutex);
 static bool statctrl_update_next_request_timestamp(struct stats_node *node,
@@ -159,6 +167,9 @@ statctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
     }
 
     void *node_data[STATS_MAX] = {mac_cache_data, mac_cache_data};
+    struct ovs_list stats_lists[STATS_MAX];
+    uint64_t request_delays[STATS_MAX];
+    uint64_t max_idle_ages[STATS_MAX];
 
     bool schedule_updated = false;
     long long now = time_msec();
@@ -166,10 +177,28 @@ statctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
     ovs_mutex_lock(&mutex);
     for (size_t i = 0; i < STATS_MAX; i++) {
         struct stats_node *node = &statctrl_ctx.nodes[i];
-        uint64_t prev_delay = node->request_delay;
 
-        node->run(&node->stats_list, &node->request_delay, node_data[i]);
+        ovs_list_init(&stats_lists[i]);
+        ovs_list_push_back_all(&stats_lists[i], &node->stats_list);
+        request_delays[i] = node->request_delay;
+        max_idle_ages[i] = node->max_idle_age;
+    }
+    ovs_mutex_unlock(&mutex);
+
+    for (size_t i = 0; i < STATS_MAX; i++) {
+        struct stats_node *node = &statctrl_ctx.nodes[i];
+
+        node->run(&stats_lists[i], &request_delays[i], &max_idle_ages[i],
+                  node_data[i]);
+    }
 
+    ovs_mutex_lock(&mutex);
+    for (size_t i = 0; i < STATS_MAX; i++) {
+        struct stats_node *node = &statctrl_ctx.nodes[i];
+        uint64_t prev_delay = node->request_delay;
+
+        node->request_delay = request_delays[i];
+        node->max_idle_age = max_idle_ages[i];
         schedule_updated |=
                 statctrl_update_next_request_timestamp(node, now, prev_delay);
     }
@@ -255,7 +284,6 @@ statctrl_thread_handler(void *arg)
             ovs_mutex_unlock(&mutex);
         }
 
-        statctrl_notify_main_thread(ctx);
         rconn_run_wait(swconn);
         rconn_recv_wait(swconn);
         ovs_mutex_lock(&mutex);
@@ -287,9 +315,24 @@ statctrl_handle_rconn_msg(struct rconn *swconn, struct statctrl_ctx *ctx,
             return;
         }
 
+        struct stats_node *node = &ctx->nodes[stype];
+        struct ovs_list stats_list = OVS_LIST_INITIALIZER(&stats_list);
+
         ovs_mutex_lock(&mutex);
-        statctrl_decode_statistics_reply(&ctx->nodes[stype], msg);
+        uint64_t max_idle_age = node->max_idle_age;
         ovs_mutex_unlock(&mutex);
+
+        statctrl_decode_statistics_reply(node, max_idle_age, &stats_list,
+                                         msg);
+        if (ovs_list_is_empty(&stats_list)) {
+            return;
+        }
+
+        ovs_mutex_lock(&mutex);
+        ovs_list_push_back_all(&node->stats_list, &stats_list);
+        ovs_mutex_unlock(&mutex);
+
+        seq_change(ctx->main_seq);
     } else {
         if (VLOG_IS_DBG_ENABLED()) {
 
@@ -315,8 +358,10 @@ statctrl_get_stat_type(struct statctrl_ctx *ctx, const struct ofp_header *oh)
 }
 
 static void
-statctrl_decode_statistics_reply(struct stats_node *node, struct ofpbuf *msg)
-    OVS_REQUIRES(mutex)
+statctrl_decode_statistics_reply(struct stats_node *node,
+                                 uint64_t max_idle_age,
+                                 struct ovs_list *stats_list,
+                                 struct ofpbuf *msg)
 {
     struct ofpbuf ofpacts;
     ofpbuf_init(&ofpacts, 0);
@@ -332,7 +377,14 @@ statctrl_decode_statistics_reply(struct stats_node *node, struct ofpbuf *msg)
             break;
         }
 
-        node->process_flow_stats(&node->stats_list, &fs);
+        /* Skip the flows that are idle for too long, the dump covers the
+         * whole table and most of the entries are usually not in use. */
+        if (fs.idle_age >= 0 &&
+            (uint64_t) fs.idle_age * 1000 >= max_idle_age) {
+            continue;
+        }
+
+        node->process_flow_stats(stats_list, &fs);
     }
 
     ofpbuf_uninit(&ofpacts);
@@ -363,17 +415,6 @@ statctrl_send_request(struct rconn *swconn, struct statctrl_ctx *ctx)
     }
 }
 
-static void
-statctrl_notify_main_thread(struct statctrl_ctx *ctx)
-{
-    for (size_t i = 0; i < STATS_MAX; i++) {
-        if (!ovs_list_is_empty(&ctx->nodes[i].stats_list)) {
-            seq_change(ctx->main_seq);
-            return;
-        }
-    }
-}
-
 static void
 statctrl_wait_next_request(struct statctrl_ctx *ctx)
     OVS_REQUIRES(mutex)
@@ -937,6 +937,30 @@ void ovnacts_encode(const struct ovnact[], size_t ovnacts_len,
                     const struct ovnact_encode_params *,
                     struct ofpbuf *ofpacts);
 
+/* A cache of the OpenFlow encodings of logical actions.
+ *
+ * The same logical actions, e.g. "next;" or "output;", appear in many logical
+ * flows, each of which is encoded once for every datapath it applies to.  The
+ * cache keeps the encoding of actions that depend only on the encode
+ * parameters, so that identical actions are encoded only once.  Actions that
+ * look up ports, allocate group or meter ids, or embed the logical flow's
+ * UUID are never cached and are always encoded afresh. */
+struct ovnacts_encode_cache {
+    /* Contains "struct ovnacts_encode_cache_entry"s. */
+    struct hmap entries;
+    size_t max_entries;     /* Flush the cache when it reaches this size. */
+};
+
+void ovnacts_encode_cache_init(struct ovnacts_encode_cache *,
+                               size_t max_entries);
+void ovnacts_encode_cache_clear(struct ovnacts_encode_cache *);
+void ovnacts_encode_cache_destroy(struct ovnacts_encode_cache *);
+bool ovnacts_encode_cached(struct ovnacts_encode_cache *,
+                           const char *actions, uint8_t ltable,
+                           const struct ovnact[], size_t ovnacts_len,
+                           const struct ovnact_encode_params *,
+                           struct ofpbuf *ofpacts);
+
 void ovnacts_free(struct ovnact[], size_t ovnacts_len);
 char *ovnact_op_to_string(uint32_t);
 int encode_ra_dnssl_opt(char *data, char *buf, int buf_len);
@@ -263,6 +263,11 @@ struct expr_symbol {
     bool must_crossproduct;
     enum expr_write_scope rw; /* Bit map indicating in which nested contexts
                                * the symbol is writeable */
+
+    /* Parsed and annotated forms of 'prereqs' and 'predicate', filled in on
+     * first use by expression annotation.  Private to expr.c. */
+    struct expr *prereqs_expr;
+    struct expr *predicate_expr;
 };
 
 void expr_symbol_format(const struct expr_symbol *, struct ds *);
@@ -463,6 +468,20 @@ bool expr_evaluate(const struct expr *, const struct flow *uflow,
                    bool (*lookup_port)(const void *aux, const char *port_name,
                                        unsigned int *portp),
                    const void *aux);
+
+/* An expression compiled for repeated evaluation against microflows.  See
+ * expr_program_compile() for more information. */
+struct expr_program;
+
+struct expr_program *expr_program_compile(const struct expr *);
+bool expr_program_evaluate(const struct expr_program *,
+                           const struct flow *uflow,
+                           bool (*lookup_port)(const void *aux,
+                                               const char *port_name,
+                                               unsigned int *portp),
+                           const void *aux);
+size_t expr_program_size(const struct expr_program *);
+void expr_program_destroy(struct expr_program *);
 
 /* Converting expressions to OpenFlow flows. */
 
@@ -553,6 +572,14 @@ void expr_constant_set_integers_diff(
                                 struct expr_constant_set *new,
                                 struct expr_constant_set **p_diff_added,
                                 struct expr_constant_set **p_diff_deleted);
+void expr_constant_set_integers_update(
+                                struct expr_constant_set *,
+                                const char *const *added, size_t n_added,
+                                const char *const *deleted, size_t n_deleted,
+                                struct expr_constant_set **p_diff_added,
+                                struct expr_constant_set **p_diff_deleted);
+struct expr_constant_set *expr_constant_set_aggregate_cidrs(
+                                const struct expr_constant_set *);
 
 
 /* Constant sets.
@@ -5762,6 +5762,205 @@ ovnacts_encode(const struct ovnact *ovnacts, size_t ovnacts_len,
     }
 }
 
+/* Caching encoded ovnacts. */
+
+/* The encode parameters that the encoding of cacheable actions depends on,
+ * plus the logical table that the actions were parsed for. */
+struct ovnacts_encode_cache_key {
+    enum ovnact_pipeline pipeline;
+    uint32_t ctrl_meter_id;
+    uint32_t common_nat_ct_zone;
+    uint8_t ltable;
+    uint8_t ingress_ptable;
+    uint8_t egress_ptable;
+    uint8_t output_ptable;
+    uint8_t lb_hairpin_ptable;
+    uint8_t lb_hairpin_reply_ptable;
+    uint8_t ct_snat_vip_ptable;
+    bool is_switch;
+    bool explicit_arp_ns_output;
+};
+
+struct ovnacts_encode_cache_entry {
+    struct hmap_node hmap_node;     /* In struct ovnacts_encode_cache. */
+    struct ovnacts_encode_cache_key key;
+    char *actions;
+    struct ofpbuf ofpacts;
+};
+
+/* Returns true if the encoding of the 'ovnacts_len' bytes of actions starting
+ * at 'ovnacts' depends only on the fields of struct ovnacts_encode_cache_key,
+ * false if it might look up ports, allocate group or meter ids, or otherwise
+ * depend on the logical flow being encoded. */
+static bool
+ovnacts_encoding_is_cacheable(const struct ovnact *ovnacts,
+                              size_t ovnacts_len)
+{
+    if (!ovnacts) {
+        return true;
+    }
+
+    const struct ovnact *a;
+    OVNACT_FOR_EACH (a, ovnacts, ovnacts_len) {
+        switch (a->type) {
+        case OVNACT_OUTPUT:
+        case OVNACT_NEXT:
+        case OVNACT_MOVE:
+        case OVNACT_PUSH:
+        case OVNACT_POP:
+        case OVNACT_EXCHANGE:
+        case OVNACT_DEC_TTL:
+        case OVNACT_CT_NEXT:
+        case OVNACT_CT_COMMIT_TO_ZONE:
+        case OVNACT_CT_DNAT:
+        case OVNACT_CT_SNAT:
+        case OVNACT_CT_DNAT_IN_CZONE:
+        case OVNACT_CT_SNAT_IN_CZONE:
+        case OVNACT_CT_CLEAR:
+        case OVNACT_CT_COMMIT_NAT:
+        case OVNACT_IGMP:
+        case OVNACT_CHECK_PKT_LARGER:
+        case OVNACT_CHK_LB_HAIRPIN:
+        case OVNACT_CHK_LB_HAIRPIN_REPLY:
+        case OVNACT_CT_SNAT_TO_VIP:
+            break;
+
+        case OVNACT_LOAD:
+            /* Loading a logical port name requires a port lookup. */
+            if (load_type(ovnact_get_LOAD(a)) != EXPR_C_INTEGER) {
+                return false;
+            }
+            break;
+
+        case OVNACT_CT_COMMIT_V2:
+        case OVNACT_CLONE:
+        case OVNACT_ARP:
+        case OVNACT_ICMP4:
+        case OVNACT_ICMP4_ERROR:
+        case OVNACT_ICMP6:
+        case OVNACT_ICMP6_ERROR:
+        case OVNACT_TCP_RESET:
+        case OVNACT_SCTP_ABORT:
+        case OVNACT_REJECT:
+        case OVNACT_ND_NA:
+        case OVNACT_ND_NA_ROUTER:
+        case OVNACT_ND_NS: {
+            const struct ovnact_nest *on
+                = ALIGNED_CAST(const struct ovnact_nest *, a);
+            if (!ovnacts_encoding_is_cacheable(on->nested, on->nested_len)) {
+                return false;
+            }
+            break;
+        }
+
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+ovnacts_encode_cache_key_init(struct ovnacts_encode_cache_key *key,
+                              uint8_t ltable,
+                              const struct ovnact_encode_params *ep)
+{
+    /* Zero the padding too, since the key is hashed and compared as bytes. */
+    memset(key, 0, sizeof *key);
+    key->pipeline = ep->pipeline;
+    key->ctrl_meter_id = ep->ctrl_meter_id;
+    key->common_nat_ct_zone = ep->common_nat_ct_zone;
+    key->ltable = ltable;
+    key->ingress_ptable = ep->ingress_ptable;
+    key->egress_ptable = ep->egress_ptable;
+    key->output_ptable = ep->output_ptable;
+    key->lb_hairpin_ptable = ep->lb_hairpin_ptable;
+    key->lb_hairpin_reply_ptable = ep->lb_hairpin_reply_ptable;
+    key->ct_snat_vip_ptable = ep->ct_snat_vip_ptable;
+    key->is_switch = ep->is_switch;
+    key->explicit_arp_ns_output = ep->explicit_arp_ns_output;
+}
+
+/* Initializes 'cache' as an empty cache that holds at most 'max_entries'
+ * encodings. */
+void
+ovnacts_encode_cache_init(struct ovnacts_encode_cache *cache,
+                          size_t max_entries)
+{
+    hmap_init(&cache->entries);
+    cache->max_entries = max_entries;
+}
+
+/* Removes all of the entries from 'cache'.  The caller must do so whenever
+ * anything that the encoding depends on outside the encode parameters
+ * changes, such as the supported OVS features. */
+void
+ovnacts_encode_cache_clear(struct ovnacts_encode_cache *cache)
+{
+    struct ovnacts_encode_cache_entry *e;
+    HMAP_FOR_EACH_POP (e, hmap_node, &cache->entries) {
+        free(e->actions);
+        ofpbuf_uninit(&e->ofpacts);
+        free(e);
+    }
+}
+
+void
+ovnacts_encode_cache_destroy(struct ovnacts_encode_cache *cache)
+{
+    if (cache) {
+        ovnacts_encode_cache_clear(cache);
+        hmap_destroy(&cache->entries);
+    }
+}
+
+/* Appends to 'ofpacts' the same ofpacts as ovnacts_encode() would for the
+ * 'ovnacts_len' bytes of actions starting at 'ovnacts', which must have been
+ * parsed from the string 'actions' for logical table 'ltable'.  If the
+ * actions can be cached, reuses an earlier encoding of the same actions with
+ * the same parameters from 'cache', or adds the new encoding to it.
+ *
+ * Returns true if the encoding came from 'cache', false otherwise. */
+bool
+ovnacts_encode_cached(struct ovnacts_encode_cache *cache,
+                      const char *actions, uint8_t ltable,
+                      const struct ovnact *ovnacts, size_t ovnacts_len,
+                      const struct ovnact_encode_params *ep,
+                      struct ofpbuf *ofpacts)
+{
+    if (!ovnacts_encoding_is_cacheable(ovnacts, ovnacts_len)) {
+        ovnacts_encode(ovnacts, ovnacts_len, ep, ofpacts);
+        return false;
+    }
+
+    struct ovnacts_encode_cache_key key;
+    ovnacts_encode_cache_key_init(&key, ltable, ep);
+    uint32_t hash = hash_string(actions, hash_bytes(&key, sizeof key, 0));
+
+    struct ovnacts_encode_cache_entry *e;
+    HMAP_FOR_EACH_WITH_HASH (e, hmap_node, hash, &cache->entries) {
+        if (!memcmp(&e->key, &key, sizeof key)
+            && !strcmp(e->actions, actions)) {
+            ofpbuf_put(ofpacts, e->ofpacts.data, e->ofpacts.size);
+            return true;
+        }
+    }
+
+    if (hmap_count(&cache->entries) >= cache->max_entries) {
+        ovnacts_encode_cache_clear(cache);
+    }
+
+    e = xmalloc(sizeof *e);
+    e->key = key;
+    e->actions = xstrdup(actions);
+    ofpbuf_init(&e->ofpacts, 0);
+    ovnacts_encode(ovnacts, ovnacts_len, ep, &e->ofpacts);
+    hmap_insert(&cache->entries, &e->hmap_node, hash);
+
+    ofpbuf_put(ofpacts, e->ofpacts.data, e->ofpacts.size);
+    return false;
+}
+
 /* Freeing ovnacts. */
 
 static void
@@ -5830,7 +6029,11 @@ ovnact_op_to_string(uint32_t ovnact_opc)
         ACTION_OPCODE(BIND_VPORT)                   \
         ACTION_OPCODE(DHCP6_SERVER)                 \
         ACTION_OPCODE(HANDLE_SVC_CHECK)             \
-        ACTION_OPCODE(BFD_MSG)
+        ACTION_OPCODE(BFD_MSG)                      \
+        ACTION_OPCODE(ACTIVATION_STRATEGY_RARP)     \
+        ACTION_OPCODE(MG_SPLIT_BUF)                 \
+        ACTION_OPCODE(DHCP_RELAY_REQ_CHK)           \
+        ACTION_OPCODE(DHCP_RELAY_RESP_CHK)
 #define ACTION_OPCODE(ENUM) \
     case ACTION_OPCODE_##ENUM: return xstrdup(#ENUM);
     ACTION_OPCODES
@@ -26,19 +26,20 @@
 #include "openvswitch/shash.h"
 #include "openvswitch/vlog.h"
 #include "ovn-util.h"
+#include "ovs-thread.h"
 #include "ovn/expr.h"
 #include "ovn/lex.h"
 #include "ovn/logical-fields.h"
+#include "packets.h"
 #include "simap.h"
 #include "sset.h"
 #include "util.h"
 
 VLOG_DEFINE_THIS_MODULE(expr);
 
-static struct expr *parse_and_annotate(const char *s,
-                                       const struct shash *symtab,
-                                       struct sset *nesting,
-                                       char **errorp);
+static struct expr *parse_and_annotate_prereqs(
+    const struct expr_symbol *, const struct shash *symtab,
+    struct sset *nesting, char **errorp);
 
 /* Returns the name of measurement level 'level'. */
 const char *
@@ -1192,6 +1193,335 @@ expr_constant_set_integers_diff(struct expr_constant_set *old,
     *p_diff_deleted = diff_deleted;
 }
 
+/* Updates 'cs', which must be a sorted integer constant set as created by
+ * expr_constant_set_create_integers(), by removing the values given as
+ * strings in 'deleted' and adding those in 'added'.  This produces the same
+ * result as re-creating 'cs' from the full new list of values, but only the
+ * changed values are parsed and 'cs' is not sorted again.
+ *
+ * The values that 'cs' actually gained and lost are stored in '*p_diff_added'
+ * and '*p_diff_deleted', with the same meaning as for
+ * expr_constant_set_integers_diff().  A string in 'added' that merely
+ * respells one in 'deleted', e.g. "ff::01" replaced by "ff::00:01", cancels
+ * out. */
+void
+expr_constant_set_integers_update(struct expr_constant_set *cs,
+                                  const char *const *added, size_t n_added,
+                                  const char *const *deleted, size_t n_deleted,
+                                  struct expr_constant_set **p_diff_added,
+                                  struct expr_constant_set **p_diff_deleted)
+{
+    struct expr_constant_set *add = expr_constant_set_create_integers(
+        added, n_added);
+    struct expr_constant_set *del = expr_constant_set_create_integers(
+        deleted, n_deleted);
+    struct expr_constant_set *diff_added, *diff_deleted;
+    expr_constant_set_integers_diff(del, add, &diff_added, &diff_deleted);
+    expr_constant_set_destroy(add);
+    free(add);
+    expr_constant_set_destroy(del);
+    free(del);
+
+    *p_diff_added = diff_added;
+    *p_diff_deleted = diff_deleted;
+    if (!diff_added && !diff_deleted) {
+        return;
+    }
+
+    /* Merge the sorted changes into the sorted values of 'cs'. */
+    size_t n_add = diff_added ? diff_added->n_values : 0;
+    size_t n_del = diff_deleted ? diff_deleted->n_values : 0;
+    struct expr_constant *values = xmalloc((cs->n_values + n_add)
+                                           * sizeof *values);
+    size_t n = 0, ai = 0, di = 0;
+    for (size_t i = 0; i < cs->n_values; i++) {
+        const struct expr_constant *c = &cs->values[i];
+
+        while (ai < n_add
+               && compare_expr_constant_integer_cb(&diff_added->values[ai],
+                                                   c) <= 0) {
+            values[n++] = diff_added->values[ai++];
+        }
+
+        int d = 1;
+        while (di < n_del
+               && (d = compare_expr_constant_integer_cb(
+                       &diff_deleted->values[di], c)) < 0) {
+            /* Not in 'cs' to begin with. */
+            di++;
+        }
+        if (di < n_del && !d) {
+            di++;
+            continue;
+        }
+        values[n++] = *c;
+    }
+    while (ai < n_add) {
+        values[n++] = diff_added->values[ai++];
+    }
+
+    free(cs->values);
+    cs->values = values;
+    cs->n_values = n;
+}
+
+/* An IPv4 or IPv6 prefix, for expr_constant_set_aggregate_cidrs().  IPv4
+ * prefixes occupy the low 32 bits of 'addr', the same way that IPv4
+ * constants occupy the low 32 bits of a union mf_subvalue. */
+struct expr_cidr {
+    struct in6_addr addr;       /* Bits beyond the prefix are zero. */
+    unsigned int plen;          /* Prefix length within the address. */
+};
+
+static int
+compare_expr_cidr(const void *a_, const void *b_)
+{
+    const struct expr_cidr *a = a_;
+    const struct expr_cidr *b = b_;
+
+    int d = memcmp(&a->addr, &b->addr, sizeof a->addr);
+    return d ? d : a->plen < b->plen ? -1 : a->plen > b->plen;
+}
+
+/* Returns the mask for a 'plen'-bit prefix of the low 'width' bits of an
+ * in6_addr. */
+static struct in6_addr
+expr_cidr_mask(unsigned int width, unsigned int plen)
+{
+    struct in6_addr mask = ipv6_create_mask(128 - width + plen);
+    struct in6_addr high = ipv6_create_mask(128 - width);
+    for (size_t i = 0; i < sizeof mask.s6_addr; i++) {
+        mask.s6_addr[i] &= ~high.s6_addr[i];
+    }
+    return mask;
+}
+
+/* If 'c' is an IPv4 or IPv6 address or CIDR prefix, converts it into
+ * '*cidr', stores its address width into '*width', and returns true.
+ * Otherwise returns false. */
+static bool
+expr_cidr_from_constant(const struct expr_constant *c, struct expr_cidr *cidr,
+                        unsigned int *width)
+{
+    size_t n_bytes;
+    if (c->format == LEX_F_IPV4) {
+        *width = 32;
+        n_bytes = sizeof(ovs_be32);
+    } else if (c->format == LEX_F_IPV6) {
+        *width = 128;
+        n_bytes = sizeof(struct in6_addr);
+    } else {
+        return false;
+    }
+
+    /* The address must fit in the low 'n_bytes' bytes. */
+    if (!is_all_zeros(&c->value, sizeof c->value - n_bytes)) {
+        return false;
+    }
+    if (!c->masked) {
+        cidr->plen = *width;
+    } else if (!is_all_zeros(&c->mask, sizeof c->mask - n_bytes)) {
+        return false;
+    } else if (*width == 32 && ip_is_cidr(c->mask.ipv4)) {
+        cidr->plen = ip_count_cidr_bits(c->mask.ipv4);
+    } else if (*width == 128 && ipv6_is_cidr(&c->mask.ipv6)) {
+        cidr->plen = ipv6_count_cidr_bits(&c->mask.ipv6);
+    } else {
+        return false;
+    }
+
+    struct in6_addr mask = expr_cidr_mask(*width, cidr->plen);
+    cidr->addr = ipv6_addr_bitand(&c->value.ipv6, &mask);
+    return true;
+}
+
+static bool
+expr_cidr_contains(const struct expr_cidr *a, const struct expr_cidr *b,
+                   unsigned int width)
+{
+    if (a->plen > b->plen) {
+        return false;
+    }
+    struct in6_addr mask = expr_cidr_mask(width, a->plen);
+    struct in6_addr prefix = ipv6_addr_bitand(&b->addr, &mask);
+    return ipv6_addr_equals(&prefix, &a->addr);
+}
+
+/* If 'a' and 'b' are the two halves of a prefix one bit shorter, replaces
+ * 'a' by that prefix and returns true.  Otherwise returns false. */
+static bool
+expr_cidr_merge(struct expr_cidr *a, const struct expr_cidr *b,
+                unsigned int width)
+{
+    if (a->plen != b->plen || !a->plen) {
+        return false;
+    }
+
+    unsigned int bit = 128 - width + a->plen - 1;
+    uint8_t bit_mask = 0x80 >> (bit % 8);
+    struct in6_addr upper = a->addr;
+    if (upper.s6_addr[bit / 8] & bit_mask) {
+        return false;
+    }
+    upper.s6_addr[bit / 8] |= bit_mask;
+    if (!ipv6_addr_equals(&upper, &b->addr)) {
+        return false;
+    }
+
+    a->plen--;
+    return true;
+}
+
+/* Reduces the 'n' prefixes in 'cidrs', which must be sorted with
+ * compare_expr_cidr(), in place to the smallest set of prefixes that covers
+ * the same addresses.  Returns the new number of prefixes. */
+static size_t
+expr_cidrs_aggregate(struct expr_cidr *cidrs, size_t n, unsigned int width)
+{
+    /* cidrs[0...n_out - 1] is a stack of disjoint prefixes in increasing
+     * order.  Because of the sort order, a prefix can only be covered by
+     * the top of the stack, and merging only ever involves the top two. */
+    size_t n_out = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (n_out && expr_cidr_contains(&cidrs[n_out - 1], &cidrs[i],
+                                        width)) {
+            continue;
+        }
+        cidrs[n_out++] = cidrs[i];
+        while (n_out >= 2 && expr_cidr_merge(&cidrs[n_out - 2],
+                                             &cidrs[n_out - 1], width)) {
+            n_out--;
+        }
+    }
+    return n_out;
+}
+
+static void
+expr_cidrs_to_constants(const struct expr_cidr *cidrs, size_t n,
+                        unsigned int width, enum lex_format format,
+                        struct expr_constant *values)
+{
+    for (size_t i = 0; i < n; i++) {
+        struct expr_constant *c = &values[i];
+        memset(c, 0, sizeof *c);
+        c->value.ipv6 = cidrs[i].addr;
+        c->format = format;
+        if (cidrs[i].plen < width) {
+            c->masked = true;
+            c->mask.ipv6 = expr_cidr_mask(width, cidrs[i].plen);
+        }
+    }
+}
+
+/* Merges the sorted integer constants in 'a' and 'b' into 'out', which must
+ * have room for all of them.  Returns the number of constants in 'out'. */
+static size_t
+expr_constants_merge(const struct expr_constant *a, size_t n_a,
+                     const struct expr_constant *b, size_t n_b,
+                     struct expr_constant *out)
+{
+    size_t n = 0, ai = 0, bi = 0;
+    while (ai < n_a && bi < n_b) {
+        out[n++] = (compare_expr_constant_integer_cb(&a[ai], &b[bi]) <= 0
+                    ? a[ai++] : b[bi++]);
+    }
+    while (ai < n_a) {
+        out[n++] = a[ai++];
+    }
+    while (bi < n_b) {
+        out[n++] = b[bi++];
+    }
+    return n;
+}
+
+/* Returns a new integer constant set that matches the same values as 'cs',
+ * which must be an integer constant set, but with its IPv4 and IPv6
+ * addresses and prefixes combined into the fewest possible CIDR prefixes.
+ * For example, 10.0.0.0, 10.0.0.1 and 10.0.0.2/31 become 10.0.0.0/30.
+ * Other values are copied unchanged.  The new set is sorted the same way as
+ * those that expr_constant_set_create_integers() returns.
+ *
+ * If 'cs' is itself sorted that way, this takes time linear in its size,
+ * otherwise it has to sort.
+ *
+ * Each value of an address set turns into at least one flow, so aggregating
+ * sets that list contiguous addresses one by one reduces the number of flows
+ * generated for them. */
+struct expr_constant_set *
+expr_constant_set_aggregate_cidrs(const struct expr_constant_set *cs)
+{
+    ovs_assert(cs->type == EXPR_C_INTEGER);
+
+    size_t n = cs->n_values;
+    struct expr_cidr *cidrs4 = xmalloc(n * sizeof *cidrs4);
+    struct expr_cidr *cidrs6 = xmalloc(n * sizeof *cidrs6);
+    struct expr_constant *others = xmalloc(n * sizeof *others);
+    size_t n4 = 0, n6 = 0, n_others = 0;
+
+    /* Constants sorted by value list the prefixes of each address family in
+     * compare_expr_cidr() order, so the prefixes normally need no sorting.
+     * Check rather than assume it, though. */
+    bool sorted = true, sorted4 = true, sorted6 = true;
+    for (size_t i = 0; i < n; i++) {
+        const struct expr_constant *c = &cs->values[i];
+        struct expr_cidr cidr;
+        unsigned int width;
+
+        if (i && compare_expr_constant_integer_cb(&cs->values[i - 1], c) > 0) {
+            sorted = false;
+        }
+        if (!expr_cidr_from_constant(c, &cidr, &width)) {
+            others[n_others++] = *c;
+        } else if (width == 32) {
+            if (n4 && compare_expr_cidr(&cidrs4[n4 - 1], &cidr) > 0) {
+                sorted4 = false;
+            }
+            cidrs4[n4++] = cidr;
+        } else {
+            if (n6 && compare_expr_cidr(&cidrs6[n6 - 1], &cidr) > 0) {
+                sorted6 = false;
+            }
+            cidrs6[n6++] = cidr;
+        }
+    }
+    if (!sorted4) {
+        qsort(cidrs4, n4, sizeof *cidrs4, compare_expr_cidr);
+    }
+    if (!sorted6) {
+        qsort(cidrs6, n6, sizeof *cidrs6, compare_expr_cidr);
+    }
+
+    n4 = expr_cidrs_aggregate(cidrs4, n4, 32);
+    n6 = expr_cidrs_aggregate(cidrs6, n6, 128);
+
+    /* The aggregated prefixes come out sorted.  Merge them with the other
+     * values. */
+    struct expr_constant *values4 = xmalloc((n4 + n6) * sizeof *values4);
+    struct expr_constant *values6 = &values4[n4];
+    expr_cidrs_to_constants(cidrs4, n4, 32, LEX_F_IPV4, values4);
+    expr_cidrs_to_constants(cidrs6, n6, 128, LEX_F_IPV6, values6);
+    free(cidrs4);
+    free(cidrs6);
+
+    struct expr_constant *tmp = xmalloc(n * sizeof *tmp);
+    size_t n_tmp = expr_constants_merge(others, n_others, values4, n4, tmp);
+
+    struct expr_constant_set *new = xzalloc(sizeof *new);
+    new->type = EXPR_C_INTEGER;
+    new->in_curlies = cs->in_curlies;
+    new->values = xmalloc(n * sizeof *new->values);
+    new->n_values = expr_constants_merge(tmp, n_tmp, values6, n6,
+                                         new->values);
+    free(tmp);
+    free(values4);
+    free(others);
+
+    if (!sorted) {
+        qsort(new->values, new->n_values, sizeof *new->values,
+              compare_expr_constant_integer_cb);
+    }
+    return new;
+}
 
 /* Adds an constant set named 'name' to 'const_sets', replacing any existing
  * constant set entry with the given name. */
@@ -1558,8 +1888,8 @@ expr_field_parse(struct lexer *lexer, const struct shash *symtab,
             if (symbol->prereqs) {
                 char *error;
                 struct sset nesting = SSET_INITIALIZER(&nesting);
-                struct expr *e = parse_and_annotate(symbol->prereqs, symtab,
-                                                    &nesting, &error);
+                struct expr *e = parse_and_annotate_prereqs(symbol, symtab,
+                                                            &nesting, &error);
                 sset_destroy(&nesting);
                 if (error) {
                     lexer_error(lexer, "%s", error);
@@ -1816,6 +2146,8 @@ expr_symtab_destroy(struct shash *symtab)
         free(symbol->name);
         free(symbol->prereqs);
         free(symbol->predicate);
+        expr_destroy(symbol->prereqs_expr);
+        expr_destroy(symbol->predicate_expr);
         free(symbol);
     }
 }
@@ -1937,6 +2269,51 @@ parse_and_annotate(const char *s, const struct shash *symtab,
     return expr;
 }
 
+/* Protects the cached expressions in struct expr_symbol. */
+static struct ovs_mutex symbol_cache_mutex = OVS_MUTEX_INITIALIZER;
+
+/* Same as parse_and_annotate(), but the first successful result is kept in
+ * '*cachep' and later calls return a copy of it, since prerequisites and
+ * predicates are expanded over and over for the same few symbols.
+ *
+ * Failures are not cached because they can depend on 'nesting'. */
+static struct expr *
+parse_and_annotate_cached(const char *s, struct expr **cachep,
+                          const struct shash *symtab, struct sset *nesting,
+                          char **errorp)
+{
+    ovs_mutex_lock(&symbol_cache_mutex);
+    struct expr *expr = *cachep ? expr_clone(*cachep) : NULL;
+    ovs_mutex_unlock(&symbol_cache_mutex);
+    if (expr) {
+        *errorp = NULL;
+        return expr;
+    }
+
+    /* Parse without holding the mutex, because annotation recursively
+     * expands other symbols. */
+    expr = parse_and_annotate(s, symtab, nesting, errorp);
+    if (expr) {
+        ovs_mutex_lock(&symbol_cache_mutex);
+        if (!*cachep) {
+            *cachep = expr_clone(expr);
+        }
+        ovs_mutex_unlock(&symbol_cache_mutex);
+    }
+    return expr;
+}
+
+static struct expr *
+parse_and_annotate_prereqs(const struct expr_symbol *symbol,
+                           const struct shash *symtab, struct sset *nesting,
+                           char **errorp)
+{
+    return parse_and_annotate_cached(
+        symbol->prereqs,
+        &CONST_CAST(struct expr_symbol *, symbol)->prereqs_expr,
+        symtab, nesting, errorp);
+}
+
 static struct expr *
 expr_annotate_cmp(struct expr *expr, const struct shash *symtab,
                   bool append_prereqs, struct sset *nesting, char **errorp)
@@ -1952,7 +2329,7 @@ expr_annotate_cmp(struct expr *expr, const struct shash *symtab,
 
     struct expr *prereqs = NULL;
     if (append_prereqs && symbol->prereqs) {
-        prereqs = parse_and_annotate(symbol->prereqs, symtab, nesting, errorp);
+        prereqs = parse_and_annotate_prereqs(symbol, symtab, nesting, errorp);
         if (!prereqs) {
             goto error;
         }
@@ -1965,8 +2342,10 @@ expr_annotate_cmp(struct expr *expr, const struct shash *symtab,
     } else if (symbol->predicate) {
         struct expr *predicate;
 
-        predicate = parse_and_annotate(symbol->predicate, symtab,
-                                       nesting, errorp);
+        predicate = parse_and_annotate_cached(
+            symbol->predicate,
+            &CONST_CAST(struct expr_symbol *, symbol)->predicate_expr,
+            symtab, nesting, errorp);
         if (!predicate) {
             goto error;
         }
@@ -2001,7 +2380,7 @@ expr_append_prereqs(struct expr *expr, const struct expr_symbol *symbol,
     struct expr *prereqs = NULL;
 
     if (symbol->prereqs) {
-        prereqs = parse_and_annotate(symbol->prereqs, symtab, nesting, errorp);
+        prereqs = parse_and_annotate_prereqs(symbol, symtab, nesting, errorp);
         if (!prereqs) {
             expr_destroy(expr);
             return NULL;
@@ -2553,11 +2932,17 @@ crush_or_supersets(struct expr *expr, const struct expr_symbol *symbol)
      * itself, to bring together duplicates and have expressions ordered by
      * mask sizes. */
     size_t n = ovs_list_size(&expr->andor);
-    struct expr **subs = xmalloc(n * sizeof *subs);
+    struct expr *subs_stub[32];
+    struct expr **subs = (n <= ARRAY_SIZE(subs_stub)
+                          ? subs_stub
+                          : xmalloc(n * sizeof *subs));
     bool has_addr_set = false;
     /* Linked list over the 'subs' array to quickly skip deleted elements,
      * i.e. the index of the next potentially non-NULL element. */
-    size_t *next = xmalloc(n * sizeof *next);
+    size_t next_stub[ARRAY_SIZE(subs_stub)];
+    size_t *next = (n <= ARRAY_SIZE(next_stub)
+                    ? next_stub
+                    : xmalloc(n * sizeof *next));
 
     size_t i = 0, j, max_n_bits = 0;
     struct expr *sub;
@@ -2676,8 +3061,10 @@ done:
         }
     }
 
-    free(next);
-    free(subs);
+    if (subs != subs_stub) {
+        free(next);
+        free(subs);
+    }
     return expr;
 }
 
@@ -2692,6 +3079,10 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
     memset(&value, 0, sizeof value);
     memset(&mask, 0, sizeof mask);
 
+    /* The last cmp merged into 'value' and 'mask', kept so that it can be
+     * reused for the result. */
+    struct expr *cmp = NULL;
+
     struct expr *sub, *next = NULL;
     LIST_FOR_EACH_SAFE (sub, next, node, &expr->andor) {
         ovs_list_remove(&sub->node);
@@ -2701,11 +3092,13 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
             if (!mf_subvalue_intersect(&value, &mask,
                                        &new->cmp.value, &new->cmp.mask,
                                        &value, &mask)) {
+                expr_destroy(cmp);
                 expr_destroy(new);
                 expr_destroy(expr);
                 return expr_create_boolean(false);
             }
-            expr_destroy(new);
+            expr_destroy(cmp);
+            cmp = new;
             break;
         case EXPR_T_AND:
             OVS_NOT_REACHED();
@@ -2714,6 +3107,7 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
             break;
         case EXPR_T_BOOLEAN:
             if (!new->boolean) {
+                expr_destroy(cmp);
                 expr_destroy(expr);
                 return new;
             }
@@ -2724,43 +3118,39 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
         }
     }
     if (ovs_list_is_empty(&expr->andor)) {
+        expr_destroy(expr);
         if (is_all_zeros(&mask, sizeof mask)) {
-            expr_destroy(expr);
+            expr_destroy(cmp);
             return expr_create_boolean(true);
         } else {
-            struct expr *cmp;
-            cmp = xzalloc(sizeof *cmp);
-            cmp->type = EXPR_T_CMP;
+            /* A nonzero 'mask' means that at least one cmp was merged. */
+            cmp->as_name = NULL;
             cmp->cmp.symbol = symbol;
             cmp->cmp.relop = EXPR_R_EQ;
             cmp->cmp.value = value;
             cmp->cmp.mask = mask;
-            expr_destroy(expr);
+            cmp->cmp.mask_n_bits = 0;
             return cmp;
         }
-    } else if (ovs_list_is_short(&expr->andor)) {
-        /* Transform "a && (b || c || d)" into "ab || ac || ad" where "ab" is
-         * computed as "a && b", etc. */
-        struct expr *disjuncts = expr_from_node(ovs_list_pop_front(&expr->andor));
-        struct expr *or;
+    }
+    expr_destroy(cmp);
 
-        or = xzalloc(sizeof *or);
-        or->type = EXPR_T_OR;
-        ovs_list_init(&or->andor);
+    if (ovs_list_is_short(&expr->andor)) {
+        /* Transform "a && (b || c || d)" into "ab || ac || ad" where "ab" is
+         * computed as "a && b", etc.  The disjunction is filtered in place. */
+        struct expr *or = expr_from_node(ovs_list_pop_front(&expr->andor));
 
-        ovs_assert(disjuncts->type == EXPR_T_OR);
-        LIST_FOR_EACH_SAFE (sub, node, &disjuncts->andor) {
+        ovs_assert(or->type == EXPR_T_OR);
+        or->as_name = NULL;
+        LIST_FOR_EACH_SAFE (sub, node, &or->andor) {
             ovs_assert(sub->type == EXPR_T_CMP);
-            ovs_list_remove(&sub->node);
-            if (mf_subvalue_intersect(&value, &mask,
-                                      &sub->cmp.value, &sub->cmp.mask,
-                                      &sub->cmp.value, &sub->cmp.mask)) {
-                ovs_list_push_back(&or->andor, &sub->node);
-            } else {
+            if (!mf_subvalue_intersect(&value, &mask,
+                                       &sub->cmp.value, &sub->cmp.mask,
+                                       &sub->cmp.value, &sub->cmp.mask)) {
+                ovs_list_remove(&sub->node);
                 expr_destroy(sub);
             }
         }
-        expr_destroy(disjuncts);
         expr_destroy(expr);
         if (ovs_list_is_empty(&or->andor)) {
             expr_destroy(or);
@@ -2909,7 +3299,10 @@ expr_sort(struct expr *expr)
     ovs_assert(expr->type == EXPR_T_AND);
 
     size_t n = ovs_list_size(&expr->andor);
-    struct expr_sort *subs = xzalloc(n * sizeof *subs);
+    struct expr_sort subs_stub[16];
+    struct expr_sort *subs = (n <= ARRAY_SIZE(subs_stub)
+                              ? subs_stub
+                              : xmalloc(n * sizeof *subs));
     struct expr *sub;
     size_t i;
 
@@ -2924,9 +3317,9 @@ expr_sort(struct expr *expr)
 
     qsort(subs, n, sizeof *subs, compare_expr_sort);
 
+    /* Rebuild the conjunction in sorted order in 'expr' itself. */
     ovs_list_init(&expr->andor);
-    expr_destroy(expr);
-    expr = NULL;
+    expr->as_name = NULL;
 
     for (i = 0; i < n; ) {
         if (subs[i].symbol) {
@@ -2954,23 +3347,27 @@ expr_sort(struct expr *expr)
                     for (size_t k = j; k < n; k++) {
                         expr_destroy(subs[k].expr);
                     }
+                    if (subs != subs_stub) {
+                        free(subs);
+                    }
                     expr_destroy(expr);
-                    expr = crushed;
-                    break;
+                    return crushed;
                 } else {
                     expr_destroy(crushed);
                 }
             } else {
-                expr = expr_combine(EXPR_T_AND, expr, crushed);
+                expr_insert_andor(expr, &expr->andor, crushed);
             }
             i = j;
         } else {
-            expr = expr_combine(EXPR_T_AND, expr, subs[i++].expr);
+            expr_insert_andor(expr, &expr->andor, subs[i++].expr);
         }
     }
-    free(subs);
+    if (subs != subs_stub) {
+        free(subs);
+    }
 
-    return expr ? expr : expr_create_boolean(true);
+    return expr_fix(expr);
 }
 
 static struct expr *expr_normalize_or(struct expr *expr);
@@ -3018,9 +3415,23 @@ expr_normalize_and(struct expr *expr)
         const struct expr_symbol *symbol = expr_get_unique_symbol(sub);
         if (!symbol || symbol->must_crossproduct) {
             struct expr *or = expr_create_andor(EXPR_T_OR);
-            struct expr *k;
+            struct expr *k, *next_k;
+
+            LIST_FOR_EACH_SAFE (k, next_k, node, &sub->andor) {
+                if (!next_k) {
+                    /* The last conjunction can take the terms of 'expr'
+                     * itself, with 'k' in place of 'sub', instead of copies
+                     * of them. */
+                    ovs_list_remove(&k->node);
+                    expr_insert_andor(expr, &sub->node, k);
+                    ovs_list_remove(&sub->node);
+                    expr_destroy(sub);
+
+                    expr->as_name = NULL;
+                    ovs_list_push_back(&or->andor, &expr->node);
+                    break;
+                }
 
-            LIST_FOR_EACH (k, node, &sub->andor) {
                 struct expr *and = expr_create_andor(EXPR_T_AND);
                 struct expr *m;
 
@@ -3040,7 +3451,6 @@ expr_normalize_and(struct expr *expr)
                 }
                 ovs_list_push_back(&or->andor, &and->node);
             }
-            expr_destroy(expr);
             return expr_normalize_or(or);
         }
     }
@@ -3700,6 +4110,198 @@ expr_evaluate(const struct expr *e, const struct flow *uflow,
     }
 }
 
+/* Compiled expressions.
+ *
+ * An expr_program is a flat array of comparisons, each of which names the
+ * instruction to continue with depending on its result.  AND and OR nodes do
+ * not appear in the program at all: they only determine where each comparison
+ * branches to, so evaluation is a single loop without recursion or list
+ * traversal, and Boolean constants and chassis conditions are folded away at
+ * compile time. */
+
+/* Pseudo-instruction indexes that end evaluation. */
+#define EXPR_INSN_FALSE UINT32_MAX
+#define EXPR_INSN_TRUE (UINT32_MAX - 1)
+
+struct expr_insn {
+    const struct mf_field *field;
+    enum expr_relop relop;
+    uint32_t on_true;           /* Next instruction if comparison holds. */
+    uint32_t on_false;          /* Next instruction otherwise. */
+
+    /* For numeric fields, the first 'field->n_bytes' bytes of 'value' and
+     * 'mask' are significant.  For string fields, 'string' is the port name
+     * to compare against. */
+    union mf_value value;
+    union mf_value mask;
+    char *string;
+};
+
+struct expr_program {
+    struct expr_insn *insns;
+    size_t n_insns, allocated_insns;
+    uint32_t start;
+};
+
+static uint32_t
+expr_program_add_cmp(struct expr_program *prog, const struct expr *e,
+                     uint32_t on_true, uint32_t on_false)
+{
+    if (prog->n_insns >= prog->allocated_insns) {
+        prog->insns = x2nrealloc(prog->insns, &prog->allocated_insns,
+                                 sizeof *prog->insns);
+    }
+
+    struct expr_insn *insn = &prog->insns[prog->n_insns];
+    const struct mf_field *field = e->cmp.symbol->field;
+    *insn = (struct expr_insn) {
+        .field = field,
+        .relop = e->cmp.relop,
+        .on_true = on_true,
+        .on_false = on_false,
+    };
+    if (e->cmp.symbol->width) {
+        int n_bytes = field->n_bytes;
+        memcpy(&insn->value, &e->cmp.value.u8[sizeof e->cmp.value - n_bytes],
+               n_bytes);
+        memcpy(&insn->mask, &e->cmp.mask.u8[sizeof e->cmp.mask - n_bytes],
+               n_bytes);
+    } else {
+        insn->string = xstrdup(e->cmp.string);
+    }
+    return prog->n_insns++;
+}
+
+/* Adds the instructions for 'e' to 'prog', such that evaluation continues at
+ * 'on_true' or 'on_false' according to the value of 'e'.  Returns the index
+ * of the instruction where evaluation of 'e' starts.
+ *
+ * Sub-expressions are compiled from last to first, so that each one already
+ * knows where its successor starts. */
+static uint32_t
+expr_program_compile__(struct expr_program *prog, const struct expr *e,
+                       uint32_t on_true, uint32_t on_false)
+{
+    const struct expr *sub;
+    uint32_t next;
+
+    switch (e->type) {
+    case EXPR_T_CMP:
+        return expr_program_add_cmp(prog, e, on_true, on_false);
+
+    case EXPR_T_AND:
+        next = on_true;
+        LIST_FOR_EACH_REVERSE (sub, node, &e->andor) {
+            next = expr_program_compile__(prog, sub, next, on_false);
+        }
+        return next;
+
+    case EXPR_T_OR:
+        next = on_false;
+        LIST_FOR_EACH_REVERSE (sub, node, &e->andor) {
+            next = expr_program_compile__(prog, sub, on_true, next);
+        }
+        return next;
+
+    case EXPR_T_BOOLEAN:
+        return e->boolean ? on_true : on_false;
+
+    case EXPR_T_CONDITION:
+        /* Same assumption as expr_evaluate(). */
+        return e->cond.not ? on_false : on_true;
+
+    default:
+        OVS_NOT_REACHED();
+    }
+}
+
+/* Compiles 'e' into a program that expr_program_evaluate() evaluates to the
+ * same result as expr_evaluate() would for 'e'.  The program does not refer
+ * to 'e', so the caller may destroy 'e' afterward.  The caller must eventually
+ * free the returned program with expr_program_destroy().
+ *
+ * Compiling pays off when the same expression is evaluated against many
+ * microflows, as with the logical flow matches in ovn-trace. */
+struct expr_program *
+expr_program_compile(const struct expr *e)
+{
+    struct expr_program *prog = xzalloc(sizeof *prog);
+    prog->start = expr_program_compile__(prog, e, EXPR_INSN_TRUE,
+                                         EXPR_INSN_FALSE);
+    return prog;
+}
+
+/* Evaluates 'prog' against microflow 'uflow' and returns the result.
+ * 'lookup_port' and 'aux' have the same meaning as for expr_evaluate(). */
+bool
+expr_program_evaluate(const struct expr_program *prog,
+                      const struct flow *uflow,
+                      bool (*lookup_port)(const void *aux,
+                                          const char *port_name,
+                                          unsigned int *portp),
+                      const void *aux)
+{
+    /* Comparisons against the same field, e.g. from an address set, are
+     * usually adjacent, so remember the last field value that was loaded. */
+    const struct mf_field *loaded = NULL;
+    union mf_value value;
+
+    uint32_t pc = prog->start;
+    while (pc < EXPR_INSN_TRUE) {
+        const struct expr_insn *insn = &prog->insns[pc];
+        const struct mf_field *field = insn->field;
+
+        int cmp;
+        if (!insn->string) {
+            if (field != loaded) {
+                mf_get_value(field, uflow, &value);
+                loaded = field;
+            }
+
+            union mf_value masked;
+            for (int i = 0; i < field->n_bytes; i++) {
+                masked.b[i] = value.b[i] & insn->mask.b[i];
+            }
+            cmp = memcmp(&masked, &insn->value, field->n_bytes);
+        } else {
+            unsigned int cst;
+            if (!lookup_port(aux, insn->string, &cst)) {
+                pc = insn->on_false;
+                continue;
+            }
+
+            struct mf_subfield sf = { .field = field, .ofs = 0,
+                                      .n_bits = field->n_bits };
+            uint64_t port = mf_get_subfield(&sf, uflow);
+            cmp = port < cst ? -1 : port > cst;
+        }
+
+        pc = (expr_relop_test(insn->relop, cmp)
+              ? insn->on_true
+              : insn->on_false);
+    }
+    return pc == EXPR_INSN_TRUE;
+}
+
+/* Returns the number of comparisons in 'prog'. */
+size_t
+expr_program_size(const struct expr_program *prog)
+{
+    return prog->n_insns;
+}
+
+void
+expr_program_destroy(struct expr_program *prog)
+{
+    if (prog) {
+        for (size_t i = 0; i < prog->n_insns; i++) {
+            free(prog->insns[i].string);
+        }
+        free(prog->insns);
+        free(prog);
+    }
+}
+
 /* Action parsing helper. */
 
 /* Checks that 'f' is 'n_bits' wide (where 'n_bits == 0' means that 'f' must be
@@ -19,6 +19,7 @@
 /* OVS includes */
 #include "include/openvswitch/thread.h"
 #include "lib/bitmap.h"
+#include "lib/hash.h"
 #include "openvswitch/vlog.h"
 
 /* OVN includes */
@@ -31,8 +32,10 @@ VLOG_DEFINE_THIS_MODULE(lflow_mgr);
 /* Static function declarations. */
 struct ovn_lflow;
 
+static struct ovn_lflow *ovn_lflow_alloc(struct lflow_table *,
+                                        size_t dp_bitmap_len);
 static void ovn_lflow_init(struct ovn_lflow *, struct ovn_datapath *od,
-                           size_t dp_bitmap_len, enum ovn_stage stage,
+                           enum ovn_stage stage,
                            uint16_t priority, char *match,
                            char *actions, char *io_port,
                            char *ctrl_meter, char *stage_hint,
@@ -42,8 +45,10 @@ static struct ovn_lflow *ovn_lflow_find(const struct hmap *lflows,
                                         uint16_t priority, const char *match,
                                         const char *actions,
                                         const char *ctrl_meter, uint32_t hash);
+static void ovn_lflow_uninit(struct ovn_lflow *lflow);
 static void ovn_lflow_destroy(struct lflow_table *lflow_table,
                               struct ovn_lflow *lflow);
+static void lflow_table_free_recycled(struct lflow_table *);
 static char *ovn_lflow_hint(const struct ovsdb_idl_row *row);
 
 static struct ovn_lflow *do_ovn_lflow_add(
@@ -68,6 +73,8 @@ static struct ovn_dp_group *ovn_dp_group_find(const struct hmap *dp_groups,
                                               const unsigned long *dpg_bitmap,
                                               size_t bitmap_len,
                                               uint32_t hash);
+static uint32_t ovn_dp_group_hash(size_t n, const unsigned long *dpg_bitmap,
+                                  size_t bitmap_len);
 static void ovn_dp_group_use(struct ovn_dp_group *);
 static void ovn_dp_group_release(struct hmap *dp_groups,
                                  struct ovn_dp_group *);
@@ -162,6 +169,7 @@ struct ovn_lflow {
 
     struct ovn_datapath *od;     /* 'logical_datapath' in SB schema.  */
     unsigned long *dpg_bitmap;   /* Bitmap of all datapaths by their 'index'.*/
+    size_t dpg_bitmap_len;       /* Number of bits allocated in 'dpg_bitmap'.*/
     enum ovn_stage stage;
     uint16_t priority;
     char *match;
@@ -187,6 +195,21 @@ struct lflow_table {
     struct hmap ls_dp_groups; /* hmap of logical switch dp groups. */
     struct hmap lr_dp_groups; /* hmap of logical router dp groups. */
     ssize_t max_seen_lflow_size;
+
+    /* lflows released by lflow_table_clear() that are kept around to be
+     * reused by the next full build of the table, along with their datapath
+     * bitmaps.  A full recompute destroys and re-creates almost the same set
+     * of lflows, so this avoids freeing and re-allocating hundreds of
+     * thousands of objects (and the resulting heap fragmentation) on every
+     * recompute.  Whatever is not reused by the build is freed by
+     * lflow_table_expand().
+     *
+     * 'recycle_lock' protects the array only when lflows are built in
+     * parallel. */
+    struct ovn_lflow **recycled;
+    size_t n_recycled;
+    size_t allocated_recycled;
+    struct ovs_mutex recycle_lock;
 };
 
 struct lflow_table *
@@ -194,6 +217,7 @@ lflow_table_alloc(void)
 {
     struct lflow_table *lflow_table = xzalloc(sizeof *lflow_table);
     lflow_table->max_seen_lflow_size = 128;
+    ovs_mutex_init(&lflow_table->recycle_lock);
 
     return lflow_table;
 }
@@ -210,9 +234,19 @@ lflow_table_init(struct lflow_table *lflow_table)
 void
 lflow_table_clear(struct lflow_table *lflow_table)
 {
+    size_t n_lflows = hmap_count(&lflow_table->entries);
+    if (lflow_table->allocated_recycled - lflow_table->n_recycled < n_lflows) {
+        lflow_table->allocated_recycled = lflow_table->n_recycled + n_lflows;
+        lflow_table->recycled = xrealloc(
+            lflow_table->recycled,
+            lflow_table->allocated_recycled * sizeof *lflow_table->recycled);
+    }
+
     struct ovn_lflow *lflow;
     HMAP_FOR_EACH_SAFE (lflow, hmap_node, &lflow_table->entries) {
-        ovn_lflow_destroy(lflow_table, lflow);
+        hmap_remove(&lflow_table->entries, &lflow->hmap_node);
+        ovn_lflow_uninit(lflow);
+        lflow_table->recycled[lflow_table->n_recycled++] = lflow;
     }
 
     ovn_dp_groups_clear(&lflow_table->ls_dp_groups);
@@ -223,6 +257,9 @@ void
 lflow_table_destroy(struct lflow_table *lflow_table)
 {
     lflow_table_clear(lflow_table);
+    lflow_table_free_recycled(lflow_table);
+    free(lflow_table->recycled);
+    ovs_mutex_destroy(&lflow_table->recycle_lock);
     hmap_destroy(&lflow_table->entries);
     ovn_dp_groups_destroy(&lflow_table->ls_dp_groups);
     ovn_dp_groups_destroy(&lflow_table->lr_dp_groups);
@@ -238,6 +275,10 @@ lflow_table_expand(struct lflow_table *lflow_table)
             lflow_table->max_seen_lflow_size) {
         lflow_table->max_seen_lflow_size = hmap_count(&lflow_table->entries);
     }
+
+    /* The build is complete, so lflows from the previous build that were
+     * not reused are not going to be needed anymore. */
+    lflow_table_free_recycled(lflow_table);
 }
 
 void
@@ -743,7 +784,7 @@ ovn_dp_group_get(struct hmap *dp_groups, size_t desired_n,
 {
     uint32_t hash;
 
-    hash = hash_int(desired_n, 0);
+    hash = ovn_dp_group_hash(desired_n, desired_bitmap, bitmap_len);
     return ovn_dp_group_find(dp_groups, desired_bitmap, bitmap_len, hash);
 }
 
@@ -790,8 +831,9 @@ ovn_dp_group_create(struct ovsdb_idl_txn *ovnsb_txn,
         /* The group in Sb is different. */
         update_dp_group = true;
         /* We can modify existing group if it's not already in use. */
-        can_modify = !ovn_dp_group_find(dp_groups, dpg_bitmap,
-                                        bitmap_len, hash_int(n, 0));
+        can_modify = !ovn_dp_group_find(
+            dp_groups, dpg_bitmap, bitmap_len,
+            ovn_dp_group_hash(n, dpg_bitmap, bitmap_len));
     }
 
     bitmap_free(dpg_bitmap);
@@ -808,7 +850,8 @@ ovn_dp_group_create(struct ovsdb_idl_txn *ovnsb_txn,
                             is_switch ? ls_datapaths : lr_datapaths);
     }
     dpg->dpg_uuid = dpg->dp_group->header_.uuid;
-    hmap_insert(dp_groups, &dpg->node, hash_int(desired_n, 0));
+    hmap_insert(dp_groups, &dpg->node,
+                ovn_dp_group_hash(desired_n, desired_bitmap, bitmap_len));
 
     return dpg;
 }
@@ -852,13 +895,54 @@ lflow_hash_lock_destroy(void)
 }
 
 /* static functions. */
+
+/* Returns a zeroed lflow with an all-zeros 'dpg_bitmap' of 'dp_bitmap_len'
+ * bits, taking it from the lflows recycled by lflow_table_clear() if
+ * possible. */
+static struct ovn_lflow *
+ovn_lflow_alloc(struct lflow_table *lflow_table, size_t dp_bitmap_len)
+    OVS_NO_THREAD_SAFETY_ANALYSIS
+{
+    struct ovn_lflow *lflow = NULL;
+    bool use_lock = parallelization_state == STATE_USE_PARALLELIZATION;
+
+    if (use_lock) {
+        ovs_mutex_lock(&lflow_table->recycle_lock);
+    }
+    if (lflow_table->n_recycled) {
+        lflow = lflow_table->recycled[--lflow_table->n_recycled];
+    }
+    if (use_lock) {
+        ovs_mutex_unlock(&lflow_table->recycle_lock);
+    }
+
+    if (!lflow) {
+        lflow = xzalloc(sizeof *lflow);
+        lflow->dpg_bitmap = bitmap_allocate(dp_bitmap_len);
+    } else {
+        unsigned long *dpg_bitmap = lflow->dpg_bitmap;
+        size_t dpg_bitmap_len = lflow->dpg_bitmap_len;
+
+        memset(lflow, 0, sizeof *lflow);
+        if (dpg_bitmap_len == dp_bitmap_len) {
+            memset(dpg_bitmap, 0, bitmap_n_bytes(dp_bitmap_len));
+            lflow->dpg_bitmap = dpg_bitmap;
+        } else {
+            bitmap_free(dpg_bitmap);
+            lflow->dpg_bitmap = bitmap_allocate(dp_bitmap_len);
+        }
+    }
+    lflow->dpg_bitmap_len = dp_bitmap_len;
+
+    return lflow;
+}
+
 static void
 ovn_lflow_init(struct ovn_lflow *lflow, struct ovn_datapath *od,
-               size_t dp_bitmap_len, enum ovn_stage stage, uint16_t priority,
+               enum ovn_stage stage, uint16_t priority,
                char *match, char *actions, char *io_port, char *ctrl_meter,
                char *stage_hint, const char *where)
 {
-    lflow->dpg_bitmap = bitmap_allocate(dp_bitmap_len);
     lflow->od = od;
     lflow->stage = stage;
     lflow->priority = priority;
@@ -936,11 +1020,11 @@ ovn_lflow_hint(const struct ovsdb_idl_row *row)
     return xasprintf("%08x", row->uuid.parts[0]);
 }
 
+/* Frees everything owned by 'lflow' except 'lflow' itself and its
+ * 'dpg_bitmap'. */
 static void
-ovn_lflow_destroy(struct lflow_table *lflow_table, struct ovn_lflow *lflow)
+ovn_lflow_uninit(struct ovn_lflow *lflow)
 {
-    hmap_remove(&lflow_table->entries, &lflow->hmap_node);
-    bitmap_free(lflow->dpg_bitmap);
     free(lflow->match);
     free(lflow->actions);
     free(lflow->io_port);
@@ -951,9 +1035,29 @@ ovn_lflow_destroy(struct lflow_table *lflow_table, struct ovn_lflow *lflow)
     LIST_FOR_EACH_SAFE (lrn, ref_list_node, &lflow->referenced_by) {
         lflow_ref_node_destroy(lrn);
     }
+}
+
+static void
+ovn_lflow_destroy(struct lflow_table *lflow_table, struct ovn_lflow *lflow)
+{
+    hmap_remove(&lflow_table->entries, &lflow->hmap_node);
+    ovn_lflow_uninit(lflow);
+    bitmap_free(lflow->dpg_bitmap);
     free(lflow);
 }
 
+static void
+lflow_table_free_recycled(struct lflow_table *lflow_table)
+{
+    while (lflow_table->n_recycled) {
+        struct ovn_lflow *lflow =
+            lflow_table->recycled[--lflow_table->n_recycled];
+
+        bitmap_free(lflow->dpg_bitmap);
+        free(lflow);
+    }
+}
+
 static struct ovn_lflow *
 do_ovn_lflow_add(struct lflow_table *lflow_table, size_t dp_bitmap_len,
                  uint32_t hash, enum ovn_stage stage, uint16_t priority,
@@ -974,11 +1078,11 @@ do_ovn_lflow_add(struct lflow_table *lflow_table, size_t dp_bitmap_len,
         return old_lflow;
     }
 
-    lflow = xzalloc(sizeof *lflow);
+    lflow = ovn_lflow_alloc(lflow_table, dp_bitmap_len);
     /* While adding new logical flows we're not setting single datapath, but
      * collecting a group.  'od' will be updated later for all flows with only
      * one datapath in a group, so it could be hashed correctly. */
-    ovn_lflow_init(lflow, NULL, dp_bitmap_len, stage, priority,
+    ovn_lflow_init(lflow, NULL, stage, priority,
                    xstrdup(match), xstrdup(actions),
                    io_port ? xstrdup(io_port) : NULL,
                    nullable_xstrdup(ctrl_meter),
@@ -1178,6 +1282,26 @@ sync_lflow_to_sb(struct ovn_lflow *lflow,
     return true;
 }
 
+/* Returns a hash of the datapath group with 'n' datapaths set in
+ * 'dpg_bitmap'.
+ *
+ * The hash covers the contents of the bitmap and not only the number of
+ * datapaths in it.  Hashing only 'n' puts every group of the same size into
+ * the same bucket, which degrades ovn_dp_group_find() into a linear series of
+ * full bitmap comparisons on large deployments where many groups have the
+ * same size.  With a content hash, bitmap_equal() is practically only called
+ * for the group that actually matches.
+ *
+ * All bits past 'bitmap_len' in the last word are expected to be zero, which
+ * holds for bitmaps created with bitmap_allocate() or bitmap_clone(). */
+static uint32_t
+ovn_dp_group_hash(size_t n, const unsigned long *dpg_bitmap,
+                  size_t bitmap_len)
+{
+    return hash_bytes(dpg_bitmap, bitmap_n_bytes(bitmap_len),
+                      hash_int(n, 0));
+}
+
 static struct ovn_dp_group *
 ovn_dp_group_find(const struct hmap *dp_groups,
                   const unsigned long *dpg_bitmap, size_t bitmap_len,
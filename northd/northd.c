@@ -3796,7 +3796,7 @@ sync_pb_for_lsp(struct ovn_port *op,
                 n_nats = 1;
                 nats = xcalloc(1, sizeof *nats);
                 struct ds nat_addr = DS_EMPTY_INITIALIZER;
-                ds_put_format(&nat_addr, "%s", nat_addresses);
+                ds_put_cstr(&nat_addr, nat_addresses);
                 if (l3dgw_ports) {
                     const struct ovn_port *l3dgw_port = (
                         is_l3dgw_port(op->peer)
@@ -3853,7 +3853,7 @@ sync_pb_for_lsp(struct ovn_port *op,
 
         if (add_router_port_garp) {
             struct ds garp_info = DS_EMPTY_INITIALIZER;
-            ds_put_format(&garp_info, "%s", op->peer->lrp_networks.ea_s);
+            ds_put_cstr(&garp_info, op->peer->lrp_networks.ea_s);
 
             for (size_t i = 0; i < op->peer->lrp_networks.n_ipv4_addrs;
                     i++) {
@@ -5846,40 +5846,47 @@ build_lswitch_learn_fdb_op(
 }
 
 static void
-build_lswitch_learn_fdb_od(
-    struct ovn_datapath *od, struct lflow_table *lflows,
-    struct lflow_ref *lflow_ref)
+build_lswitch_learn_fdb_default(const unsigned long *dp_bitmap,
+                                size_t dp_bitmap_len,
+                                struct lflow_table *lflows)
 {
-    ovs_assert(od->nbs);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_LOOKUP_FDB, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_PUT_FDB, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_L2_LKUP, 0, "1",
-                  "outport = get_fdb(eth.dst); next;", lflow_ref);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_IN_LOOKUP_FDB, 0, "1", "next;",
+                                NULL, NULL);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_IN_PUT_FDB, 0, "1", "next;",
+                                NULL, NULL);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_IN_L2_LKUP, 0, "1",
+                                "outport = get_fdb(eth.dst); next;",
+                                NULL, NULL);
 }
 
 /* Egress tables 8: Egress port security - IP (priority 0)
  * Egress table 9: Egress port security L2 - multicast/broadcast
  *                 (priority 100). */
 static void
-build_lswitch_output_port_sec_od(struct ovn_datapath *od,
-                                 struct lflow_table *lflows,
-                                 struct lflow_ref *lflow_ref)
-{
-    ovs_assert(od->nbs);
-    ovn_lflow_add(lflows, od, S_SWITCH_OUT_CHECK_PORT_SEC, 100,
-                  "eth.mcast", REGBIT_PORT_SEC_DROP" = 0; next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_OUT_CHECK_PORT_SEC, 0, "1",
-                  REGBIT_PORT_SEC_DROP" = check_out_port_sec(); next;",
-                  lflow_ref);
-
-    ovn_lflow_add(lflows, od, S_SWITCH_OUT_APPLY_PORT_SEC, 50,
-                  REGBIT_PORT_SEC_DROP" == 1", debug_drop_action(),
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_OUT_APPLY_PORT_SEC, 0,
-                  "1", "output;", lflow_ref);
+build_lswitch_output_port_sec_default(const unsigned long *dp_bitmap,
+                                      size_t dp_bitmap_len,
+                                      struct lflow_table *lflows)
+{
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_OUT_CHECK_PORT_SEC, 100,
+                                "eth.mcast", REGBIT_PORT_SEC_DROP" = 0; next;",
+                                NULL, NULL);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_OUT_CHECK_PORT_SEC, 0, "1",
+                                REGBIT_PORT_SEC_DROP
+                                " = check_out_port_sec(); next;",
+                                NULL, NULL);
+
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_OUT_APPLY_PORT_SEC, 50,
+                                REGBIT_PORT_SEC_DROP" == 1",
+                                debug_drop_action(), NULL, NULL);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_OUT_APPLY_PORT_SEC, 0,
+                                "1", "output;", NULL, NULL);
 }
 
 static void
@@ -6439,7 +6446,7 @@ build_acl_log(struct ds *actions, const struct nbrec_acl *acl,
     if (acl->severity) {
         ds_put_format(actions, "severity=%s, ", acl->severity);
     } else {
-        ds_put_format(actions, "severity=info, ");
+        ds_put_cstr(actions, "severity=info, ");
     }
 
     if (!strcmp(acl->action, "drop")) {
@@ -6907,7 +6914,7 @@ build_acls(const struct ls_stateful_record *ls_stateful_rec,
          * Subsequent packets will hit the flow at priority 0 that just
          * uses "next;". */
         ds_clear(&match);
-        ds_put_format(&match, "ip && ct.est && ct_mark.blocked == 1");
+        ds_put_cstr(&match, "ip && ct.est && ct_mark.blocked == 1");
         ovn_lflow_add(lflows, od, S_SWITCH_IN_ACL_EVAL, 1,
                       ds_cstr(&match),
                       REGBIT_CONNTRACK_COMMIT" = 1; "
@@ -7591,27 +7598,29 @@ build_lb_affinity_ls_flows(struct lflow_table *lflows,
 }
 
 static void
-build_lswitch_lb_affinity_default_flows(struct ovn_datapath *od,
-                                        struct lflow_table *lflows,
-                                        struct lflow_ref *lflow_ref)
+build_lswitch_lb_affinity_default_flows(const unsigned long *dp_bitmap,
+                                        size_t dp_bitmap_len,
+                                        struct lflow_table *lflows)
 {
-    ovs_assert(od->nbs);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_LB_AFF_CHECK, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_LB_AFF_LEARN, 0, "1", "next;",
-                  lflow_ref);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_IN_LB_AFF_CHECK, 0, "1", "next;",
+                                NULL, NULL);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_IN_LB_AFF_LEARN, 0, "1", "next;",
+                                NULL, NULL);
 }
 
 static void
-build_lrouter_lb_affinity_default_flows(struct ovn_datapath *od,
-                                        struct lflow_table *lflows,
-                                        struct lflow_ref *lflow_ref)
+build_lrouter_lb_affinity_default_flows(const unsigned long *dp_bitmap,
+                                        size_t dp_bitmap_len,
+                                        struct lflow_table *lflows)
 {
-    ovs_assert(od->nbr);
-    ovn_lflow_add(lflows, od, S_ROUTER_IN_LB_AFF_CHECK, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_ROUTER_IN_LB_AFF_LEARN, 0, "1", "next;",
-                  lflow_ref);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_ROUTER_IN_LB_AFF_CHECK, 0, "1", "next;",
+                                NULL, NULL);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_ROUTER_IN_LB_AFF_LEARN, 0, "1", "next;",
+                                NULL, NULL);
 }
 
 static void
@@ -9131,13 +9140,13 @@ build_lswitch_arp_nd_responder_known_ips(struct ovn_port *op,
 /* Ingress table 19: ARP/ND responder, by default goto next.
  * (priority 0)*/
 static void
-build_lswitch_arp_nd_responder_default(struct ovn_datapath *od,
-                                       struct lflow_table *lflows,
-                                       struct lflow_ref *lflow_ref)
+build_lswitch_arp_nd_responder_default(const unsigned long *dp_bitmap,
+                                       size_t dp_bitmap_len,
+                                       struct lflow_table *lflows)
 {
-    ovs_assert(od->nbs);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_ARP_ND_RSP, 0, "1", "next;",
-                  lflow_ref);
+    ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                S_SWITCH_IN_ARP_ND_RSP, 0, "1", "next;",
+                                NULL, NULL);
 }
 
 /* Ingress table 19: ARP/ND responder for service monitor source ip.
@@ -9285,21 +9294,22 @@ build_lswitch_dhcp_options_and_response(struct ovn_port *op,
  * Ingress table 24 - External port handling, by default goto next.
  * (priority 0). */
 static void
-build_lswitch_dhcp_and_dns_defaults(struct ovn_datapath *od,
-                                    struct lflow_table *lflows,
-                                    struct lflow_ref *lflow_ref)
-{
-    ovs_assert(od->nbs);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_DHCP_OPTIONS, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_DHCP_RESPONSE, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_DNS_LOOKUP, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_DNS_RESPONSE, 0, "1", "next;",
-                  lflow_ref);
-    ovn_lflow_add(lflows, od, S_SWITCH_IN_EXTERNAL_PORT, 0, "1", "next;",
-                  lflow_ref);
+build_lswitch_dhcp_and_dns_defaults(const unsigned long *dp_bitmap,
+                                    size_t dp_bitmap_len,
+                                    struct lflow_table *lflows)
+{
+    static const enum ovn_stage stages[] = {
+        S_SWITCH_IN_DHCP_OPTIONS,
+        S_SWITCH_IN_DHCP_RESPONSE,
+        S_SWITCH_IN_DNS_LOOKUP,
+        S_SWITCH_IN_DNS_RESPONSE,
+        S_SWITCH_IN_EXTERNAL_PORT,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(stages); i++) {
+        ovn_lflow_add_with_dp_group(lflows, dp_bitmap, dp_bitmap_len,
+                                    stages[i], 0, "1", "next;", NULL, NULL);
+    }
 }
 
 /* Logical switch ingress table 22 and 23: DNS lookup and response
@@ -10036,7 +10046,7 @@ build_routing_policy_flow(struct lflow_table *lflows, struct ovn_datapath *od,
         }
         ds_put_cstr(&actions, REG_ECMP_GROUP_ID" = 0; next;");
     }
-    ds_put_format(&match, "%s", rule->match);
+    ds_put_cstr(&match, rule->match);
 
     ovn_lflow_add_with_hint(lflows, od, S_ROUTER_IN_POLICY, rule->priority,
                             ds_cstr(&match), ds_cstr(&actions), stage_hint,
@@ -10858,7 +10868,7 @@ add_route(struct lflow_table *lflows, struct ovn_datapath *od,
                             ds_cstr(&actions), stage_hint,
                             lflow_ref);
     if (op && op->has_bfd) {
-        ds_put_format(&match, " && udp.dst == 3784");
+        ds_put_cstr(&match, " && udp.dst == 3784");
         ovn_lflow_add_with_hint(lflows, op->od,
                                 S_ROUTER_IN_IP_ROUTING,
                                 priority + 1, ds_cstr(&match),
@@ -10907,7 +10917,7 @@ static void
 op_put_v4_networks(struct ds *ds, const struct ovn_port *op, bool add_bcast)
 {
     if (!add_bcast && op->lrp_networks.n_ipv4_addrs == 1) {
-        ds_put_format(ds, "%s", op->lrp_networks.ipv4_addrs[0].addr_s);
+        ds_put_cstr(ds, op->lrp_networks.ipv4_addrs[0].addr_s);
         return;
     }
 
@@ -10927,7 +10937,7 @@ static void
 op_put_v6_networks(struct ds *ds, const struct ovn_port *op)
 {
     if (op->lrp_networks.n_ipv6_addrs == 1) {
-        ds_put_format(ds, "%s", op->lrp_networks.ipv6_addrs[0].addr_s);
+        ds_put_cstr(ds, op->lrp_networks.ipv6_addrs[0].addr_s);
         return;
     }
 
@@ -12253,7 +12263,7 @@ build_adm_ctrl_flows_for_lrouter_port(
                       op->peer->proxy_arp_addrs.ea_s,
                       op->lrp_networks.ea_s);
     } else {
-        ds_put_format(match, "%s", op->lrp_networks.ea_s);
+        ds_put_cstr(match, op->lrp_networks.ea_s);
     }
     ds_put_format(match, " && inport == %s", op->json_key);
     if (consider_l3dgw_port_is_centralized(op)) {
@@ -13778,7 +13788,7 @@ build_dhcp_relay_flows_for_lrouter_port(struct ovn_port *op,
         "udp.src == 68 && udp.dst == 67 && "
         REGBIT_DHCP_RELAY_REQ_CHK" == 0",
         op->json_key);
-    ds_put_format(actions, "drop; /* DHCP_RELAY_REQ */");
+    ds_put_cstr(actions, "drop; /* DHCP_RELAY_REQ */");
 
     ovn_lflow_add_with_hint(lflows, op->od, S_ROUTER_IN_DHCP_RELAY_REQ, 1,
                             ds_cstr(match), ds_cstr(actions),
@@ -13791,7 +13801,7 @@ build_dhcp_relay_flows_for_lrouter_port(struct ovn_port *op,
         match, "ip4.src == %s && ip4.dst == %s && "
         "ip.frag == 0 && udp.src == 67 && udp.dst == 67",
         server_ip_str, op->lrp_networks.ipv4_addrs[0].addr_s);
-    ds_put_format(actions, "next; /* DHCP_RELAY_RESP */");
+    ds_put_cstr(actions, "next; /* DHCP_RELAY_RESP */");
     ovn_lflow_add_with_hint(lflows, op->od, S_ROUTER_IN_IP_INPUT, 110,
                             ds_cstr(match), ds_cstr(actions),
                             &op->nbrp->header_, lflow_ref);
@@ -13840,7 +13850,7 @@ build_dhcp_relay_flows_for_lrouter_port(struct ovn_port *op,
                   "udp.src == 67 && udp.dst == 67 && "
                   REGBIT_DHCP_RELAY_RESP_CHK" == 0",
                   server_ip_str, op->lrp_networks.ipv4_addrs[0].addr_s);
-    ds_put_format(actions, "drop; /* DHCP_RELAY_RESP */");
+    ds_put_cstr(actions, "drop; /* DHCP_RELAY_RESP */");
     ovn_lflow_add_with_hint(lflows, op->od, S_ROUTER_IN_DHCP_RELAY_RESP,
                             1, ds_cstr(match), ds_cstr(actions),
                             &op->nbrp->header_, lflow_ref);
@@ -14558,7 +14568,7 @@ build_lrouter_in_dnat_flow(struct lflow_table *lflows,
         if (nat->external_port_range[0]) {
             ds_put_format(actions, ",%s", nat->external_port_range);
         }
-        ds_put_format(actions, ");");
+        ds_put_cstr(actions, ");");
     }
 
     if (nat->match[0]) {
@@ -14610,7 +14620,7 @@ build_lrouter_out_undnat_flow(struct lflow_table *lflows,
     }
 
     if (stateless) {
-        ds_put_format(actions, "next;");
+        ds_put_cstr(actions, "next;");
     } else {
         ds_put_cstr(actions, lrouter_use_common_zone(od)
                     ? "ct_dnat_in_czone;"
@@ -14760,7 +14770,7 @@ build_lrouter_out_snat_in_czone_flow(struct lflow_table *lflows,
         ds_put_format(&zone_actions, "eth.src = "ETH_ADDR_FMT"; ",
                       ETH_ADDR_ARGS(mac));
     }
-    ds_put_format(match, " && (!ct.trk || !ct.rpl)");
+    ds_put_cstr(match, " && (!ct.trk || !ct.rpl)");
 
     ds_put_cstr(&zone_actions, REGBIT_DST_NAT_IP_LOCAL" = 0; ");
 
@@ -14823,7 +14833,7 @@ build_lrouter_out_snat_flow(struct lflow_table *lflows,
     if (nat->external_port_range[0]) {
         ds_put_format(actions, ",%s", nat->external_port_range);
     }
-    ds_put_format(actions, ");");
+    ds_put_cstr(actions, ");");
 
     ovn_lflow_add_with_hint(lflows, od, S_ROUTER_OUT_SNAT,
                             priority, ds_cstr(match),
@@ -15466,11 +15476,11 @@ build_lrouter_nat_defrag_and_lb(
             }
 
             ds_clear(actions);
-            ds_put_format(actions,
-                          "clone { ct_clear; "
-                          "inport = outport; outport = \"\"; "
-                          "eth.dst <-> eth.src; "
-                          "flags = 0; flags.loopback = 1; ");
+            ds_put_cstr(actions,
+                        "clone { ct_clear; "
+                        "inport = outport; outport = \"\"; "
+                        "eth.dst <-> eth.src; "
+                        "flags = 0; flags.loopback = 1; ");
             if (use_common_zone) {
                 ds_put_cstr(actions, "flags.use_snat_zone = "
                             REGBIT_DST_NAT_IP_LOCAL"; ");
@@ -15815,15 +15825,10 @@ build_lswitch_and_lrouter_iterate_by_ls(struct ovn_datapath *od,
 
     build_fwd_group_lflows(od, lsi->lflows, NULL);
     build_lswitch_lflows_admission_control(od, lsi->lflows, NULL);
-    build_lswitch_learn_fdb_od(od, lsi->lflows, NULL);
-    build_lswitch_arp_nd_responder_default(od, lsi->lflows, NULL);
     build_lswitch_dns_lookup_and_response(od, lsi->lflows, lsi->meter_groups,
                                           NULL);
-    build_lswitch_dhcp_and_dns_defaults(od, lsi->lflows, NULL);
     build_lswitch_destination_lookup_bmcast(od, lsi->lflows, &lsi->actions,
                                             lsi->meter_groups, NULL);
-    build_lswitch_output_port_sec_od(od, lsi->lflows, NULL);
-    build_lswitch_lb_affinity_default_flows(od, lsi->lflows, NULL);
     build_lswitch_lflows_l2_unknown(od, lsi->lflows, NULL);
 }
 
@@ -15862,12 +15867,48 @@ build_lswitch_and_lrouter_iterate_by_lr(struct ovn_datapath *od,
     build_misc_local_traffic_drop_flows_for_lrouter(od, lsi->lflows, NULL);
 
     build_lr_nat_defrag_and_lb_default_flows(od, lsi->lflows, NULL);
-    build_lrouter_lb_affinity_default_flows(od, lsi->lflows, NULL);
+}
+
+/* Helper function to combine all lflow generation that doesn't depend on
+ * the configuration of the datapath, i.e., the flows that are identical for
+ * every logical switch or for every logical router.
+ *
+ * These flows are added only once, with a datapath group that contains all
+ * switches (or all routers), instead of being generated, hashed and looked
+ * up in the lflow table separately for each datapath.  They end up in the
+ * same datapath groups either way.
+ *
+ * This must be called only once per build, by a single thread. */
+static void
+build_lswitch_and_lrouter_default_flows(struct lswitch_flow_build_info *lsi)
+{
+    size_t n_ls = ods_size(lsi->ls_datapaths);
+    size_t n_lr = ods_size(lsi->lr_datapaths);
 
-    /* Default drop rule in lr_out_delivery stage.  See
-     * build_egress_delivery_flows_for_lrouter_port() which adds a rule
-     * for each router port. */
-    ovn_lflow_add_default_drop(lsi->lflows, od, S_ROUTER_OUT_DELIVERY, NULL);
+    if (n_ls) {
+        unsigned long *ls_bitmap = bitmap_allocate1(n_ls);
+
+        build_lswitch_learn_fdb_default(ls_bitmap, n_ls, lsi->lflows);
+        build_lswitch_arp_nd_responder_default(ls_bitmap, n_ls, lsi->lflows);
+        build_lswitch_dhcp_and_dns_defaults(ls_bitmap, n_ls, lsi->lflows);
+        build_lswitch_output_port_sec_default(ls_bitmap, n_ls, lsi->lflows);
+        build_lswitch_lb_affinity_default_flows(ls_bitmap, n_ls, lsi->lflows);
+        bitmap_free(ls_bitmap);
+    }
+
+    if (n_lr) {
+        unsigned long *lr_bitmap = bitmap_allocate1(n_lr);
+
+        build_lrouter_lb_affinity_default_flows(lr_bitmap, n_lr, lsi->lflows);
+
+        /* Default drop rule in lr_out_delivery stage.  See
+         * build_egress_delivery_flows_for_lrouter_port() which adds a rule
+         * for each router port. */
+        ovn_lflow_add_with_dp_group(lsi->lflows, lr_bitmap, n_lr,
+                                    S_ROUTER_OUT_DELIVERY, 0, "1",
+                                    debug_drop_action(), NULL, NULL);
+        bitmap_free(lr_bitmap);
+    }
 }
 
 /* Helper function to combine all lflow generation which is iterated by logical
@@ -15964,6 +16005,9 @@ build_lflows_thread(void *arg)
         }
         thread_lflow_counter = 0;
         if (lsi) {
+            if (!control->id) {
+                build_lswitch_and_lrouter_default_flows(lsi);
+            }
             /* Iterate over bucket ThreadID, ThreadID+size, ... */
             for (bnum = control->id;
                     bnum <= lsi->ls_datapaths->datapaths.mask;
@@ -16243,6 +16287,7 @@ build_lswitch_and_lrouter_flows(
          * will move here and will be reogranized by iterator type.
          */
         stopwatch_start(LFLOWS_DATAPATHS_STOPWATCH_NAME, time_msec());
+        build_lswitch_and_lrouter_default_flows(&lsi);
         HMAP_FOR_EACH (od, key_node, &ls_datapaths->datapaths) {
             build_lswitch_and_lrouter_iterate_by_ls(od, &lsi);
         }
@@ -23,6 +23,7 @@
 #include "daemon.h"
 #include "fatal-signal.h"
 #include "inc-proc-northd.h"
+#include "lib/inc-proc-eng.h"
 #include "lib/ip-mcast-index.h"
 #include "lib/mcast-group-index.h"
 #include "lib/memory-trim.h"
@@ -58,6 +59,15 @@ static unixctl_cb_func ovn_northd_get_thread_count_cmd;
 struct northd_state {
     bool had_lock;
     bool paused;
+
+    /* Time when the SB lock was last acquired, and the time it took from
+     * then until the first engine run completed without being canceled,
+     * i.e., until this instance caught up with the NB and SB contents and
+     * could commit its changes.
+     * 'takeover_ms' is -1 until the first takeover completes. */
+    long long int lock_acquired_msec;
+    long long int takeover_ms;
+    bool takeover_pending;
 };
 
 #define OVN_MAX_SUPPORTED_THREADS 256
@@ -763,7 +773,8 @@ main(int argc, char *argv[])
     int n_threads = 1;
     struct northd_state state = {
         .had_lock = false,
-        .paused = false
+        .paused = false,
+        .takeover_ms = -1,
     };
 
     fatal_ignore_sigpipe();
@@ -954,12 +965,15 @@ main(int argc, char *argv[])
                 VLOG_INFO("ovn-northd lock acquired. "
                         "This ovn-northd instance is now active.");
                 state.had_lock = true;
+                state.lock_acquired_msec = time_msec();
+                state.takeover_pending = true;
             } else if (state.had_lock &&
                        !ovsdb_idl_has_lock(ovnsb_idl_loop.idl))
             {
                 VLOG_INFO("ovn-northd lock lost. "
                         "This ovn-northd instance is now on standby.");
                 state.had_lock = false;
+                state.takeover_pending = false;
             }
 
             if (ovsdb_idl_has_lock(ovnsb_idl_loop.idl)) {
@@ -970,6 +984,15 @@ main(int argc, char *argv[])
                     activity = inc_proc_northd_run(ovnnb_txn, ovnsb_txn,
                                                    &eng_ctx);
                     eng_ctx.recompute = false;
+                    if (state.takeover_pending && engine_has_run()
+                        && !engine_canceled()) {
+                        state.takeover_pending = false;
+                        state.takeover_ms =
+                            time_msec() - state.lock_acquired_msec;
+                        VLOG_INFO("ovn-northd caught up with the databases "
+                                  "%lld ms after acquiring the lock.",
+                                  state.takeover_ms);
+                    }
                     check_and_add_supported_dhcp_opts_to_sb_db(
                                  ovnsb_txn, ovnsb_idl_loop.idl);
                     check_and_add_supported_dhcpv6_opts_to_sb_db(
@@ -1022,6 +1045,7 @@ main(int argc, char *argv[])
                 VLOG_INFO("This ovn-northd instance is now paused.");
                 ovsdb_idl_set_lock(ovnsb_idl_loop.idl, NULL);
                 state.had_lock = false;
+                state.takeover_pending = false;
             }
 
             ovsdb_idl_run(ovnnb_idl_loop.idl);
@@ -1143,6 +1167,12 @@ ovn_northd_status(struct unixctl_conn *conn, int argc OVS_UNUSED,
      */
     struct ds s = DS_EMPTY_INITIALIZER;
     ds_put_format(&s, "Status: %s\n", status);
+    if (state->takeover_pending) {
+        ds_put_format(&s, "Takeover: in progress for %lld ms\n",
+                      time_msec() - state->lock_acquired_msec);
+    } else if (state->takeover_ms >= 0) {
+        ds_put_format(&s, "Last takeover: %lld ms\n", state->takeover_ms);
+    }
     unixctl_command_reply(conn, ds_cstr(&s));
     ds_destroy(&s);
 }
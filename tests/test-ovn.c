@@ -24,6 +24,7 @@
 #include "fatal-signal.h"
 #include "flow.h"
 #include "openvswitch/dynamic-string.h"
+#include "openvswitch/json.h"
 #include "openvswitch/match.h"
 #include "openvswitch/ofp-actions.h"
 #include "openvswitch/ofpbuf.h"
@@ -39,6 +40,8 @@
 #include "ovstest.h"
 #include "openvswitch/shash.h"
 #include "simap.h"
+#include "svec.h"
+#include "timeval.h"
 #include "util.h"
 #include "controller/lflow.h"
 
@@ -451,7 +454,14 @@ test_evaluate_expr(struct ovs_cmdl_context *ctx)
             expr = expr_annotate(expr, &symtab, &error);
         }
         if (!error) {
-            printf("%d\n", expr_evaluate(expr, &uflow, lookup_atoi_cb, NULL));
+            bool result = expr_evaluate(expr, &uflow, lookup_atoi_cb, NULL);
+
+            struct expr_program *prog = expr_program_compile(expr);
+            ovs_assert(expr_program_evaluate(prog, &uflow, lookup_atoi_cb,
+                                             NULL) == result);
+            expr_program_destroy(prog);
+
+            printf("%d\n", result);
         } else {
             puts(error);
             free(error);
@@ -463,6 +473,333 @@ test_evaluate_expr(struct ovs_cmdl_context *ctx)
     expr_symtab_destroy(&symtab);
     shash_destroy(&symtab);
 }
+
+/* Benchmarks.
+ *
+ * Each benchmark command prints one JSON object per line on stdout for every
+ * input and stage that it measures, e.g.:
+ *
+ *     {"input":"ip4","iterations":1000,"ops_per_sec":1176470.6,
+ *      "stage":"parse","usec":850}
+ *
+ * so that scripts can collect the results and compare them across builds. */
+
+static int
+parse_benchmark_iterations(const char *s)
+{
+    int n_iterations = atoi(s);
+    if (n_iterations <= 0) {
+        ovs_fatal(0, "%s: invalid number of iterations", s);
+    }
+    return n_iterations;
+}
+
+/* Returns a JSON object that describes running 'stage' of processing 'input'
+ * 'n_iterations' times in 'usec' microseconds.  Callers may add more members
+ * before passing it to benchmark_print(). */
+static struct json *
+benchmark_record(const char *input, const char *stage, int n_iterations,
+                 long long int usec)
+{
+    struct json *json = json_object_create();
+    json_object_put_string(json, "input", input);
+    json_object_put_string(json, "stage", stage);
+    json_object_put(json, "iterations", json_integer_create(n_iterations));
+    json_object_put(json, "usec", json_integer_create(usec));
+    json_object_put(json, "ops_per_sec",
+                    json_real_create(n_iterations * 1e6 / MAX(usec, 1)));
+    return json;
+}
+
+/* Prints 'json' on its own line and destroys it. */
+static void
+benchmark_print(struct json *json)
+{
+    char *s = json_to_string(json, JSSF_SORT);
+    puts(s);
+    free(s);
+    json_destroy(json);
+}
+
+static void
+benchmark_report(const char *input, const char *stage, int n_iterations,
+                 long long int usec)
+{
+    benchmark_print(benchmark_record(input, stage, n_iterations, usec));
+}
+
+/* Adds an address set named 'name' with 'n' distinct IPv4 addresses to
+ * 'addr_sets', for benchmarking expressions that refer to large sets. */
+static void
+create_benchmark_addr_set(struct shash *addr_sets, const char *name, int n)
+{
+    char **addrs = xmalloc(n * sizeof *addrs);
+    for (int i = 0; i < n; i++) {
+        addrs[i] = xasprintf("10.%d.%d.%d",
+                             (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+    }
+    expr_const_sets_add_integers(addr_sets, name,
+                                 (const char *const *) addrs, n);
+    for (int i = 0; i < n; i++) {
+        free(addrs[i]);
+    }
+    free(addrs);
+}
+
+/* Benchmarked expressions are processed in batches, so that copying their
+ * inputs and destroying their results stays outside the timed region. */
+#define BENCHMARK_BATCH 32
+
+struct benchmark_expr_aux {
+    struct shash *symtab;
+    struct simap *ports;
+};
+
+static struct expr *
+benchmark_annotate(struct expr *expr, const struct benchmark_expr_aux *aux)
+{
+    char *error;
+    expr = expr_annotate(expr, aux->symtab, &error);
+    free(error);
+    return expr;
+}
+
+static struct expr *
+benchmark_simplify(struct expr *expr, const struct benchmark_expr_aux *aux)
+{
+    expr = expr_simplify(expr);
+    return expr_evaluate_condition(expr, is_chassis_resident_cb, aux->ports);
+}
+
+static struct expr *
+benchmark_normalize(struct expr *expr,
+                    const struct benchmark_expr_aux *aux OVS_UNUSED)
+{
+    return expr_normalize(expr);
+}
+
+/* Runs 'stage' on 'n_iterations' copies of 'in' and returns the time that
+ * 'stage' took, in microseconds. */
+static long long int
+benchmark_expr_stage(const struct expr *in,
+                     struct expr *(*stage)(struct expr *,
+                                           const struct benchmark_expr_aux *),
+                     const struct benchmark_expr_aux *aux, int n_iterations)
+{
+    struct expr *exprs[BENCHMARK_BATCH];
+    long long int usec = 0;
+
+    for (int i = 0; i < n_iterations; i += BENCHMARK_BATCH) {
+        int n = MIN(BENCHMARK_BATCH, n_iterations - i);
+        for (int j = 0; j < n; j++) {
+            exprs[j] = expr_clone(in);
+        }
+
+        long long int start = time_usec();
+        for (int j = 0; j < n; j++) {
+            exprs[j] = stage(exprs[j], aux);
+        }
+        usec += time_usec() - start;
+
+        for (int j = 0; j < n; j++) {
+            expr_destroy(exprs[j]);
+        }
+    }
+    return usec;
+}
+
+static void
+test_benchmark_expr(struct ovs_cmdl_context *ctx)
+{
+    int n_iterations = parse_benchmark_iterations(ctx->argv[1]);
+    int addr_set_size = ctx->argc > 2 ? atoi(ctx->argv[2]) : 10000;
+
+    struct shash symtab;
+    struct shash addr_sets;
+    struct shash port_groups;
+    struct simap ports;
+
+    ovn_init_symtab(&symtab);
+    create_addr_sets(&addr_sets);
+    create_benchmark_addr_set(&addr_sets, "big", MAX(addr_set_size, 0));
+    create_port_groups(&port_groups);
+
+    simap_init(&ports);
+    simap_put(&ports, "lsp1", 0x11);
+    simap_put(&ports, "lsp2", 0x12);
+    simap_put(&ports, "lsp3", 0x13);
+
+    struct benchmark_expr_aux aux = {
+        .symtab = &symtab,
+        .ports = &ports,
+    };
+
+    struct ds input;
+    ds_init(&input);
+    while (!ds_get_test_line(&input, stdin)) {
+        const char *s = ds_cstr(&input);
+
+        /* Run all the stages once, both to check that the input is valid and
+         * to obtain the input of each stage. */
+        char *error;
+        struct expr *parsed = expr_parse_string(s, &symtab, &addr_sets,
+                                                &port_groups, NULL, NULL, 0,
+                                                &error);
+        struct expr *annotated = NULL;
+        if (!error) {
+            annotated = expr_annotate(expr_clone(parsed), &symtab, &error);
+        }
+        if (error) {
+            puts(error);
+            free(error);
+            expr_destroy(parsed);
+            expr_destroy(annotated);
+            continue;
+        }
+        struct expr *simplified = benchmark_simplify(expr_clone(annotated),
+                                                     &aux);
+        struct expr *normalized = expr_normalize(expr_clone(simplified));
+
+        long long int start = time_usec();
+        for (int i = 0; i < n_iterations; i++) {
+            struct lexer lexer;
+
+            lexer_init(&lexer, s);
+            while (lexer_get(&lexer) != LEX_T_END) {
+                continue;
+            }
+            lexer_destroy(&lexer);
+        }
+        benchmark_report(s, "lex", n_iterations, time_usec() - start);
+
+        long long int usec = 0;
+        for (int i = 0; i < n_iterations; i += BENCHMARK_BATCH) {
+            struct expr *exprs[BENCHMARK_BATCH];
+            int n = MIN(BENCHMARK_BATCH, n_iterations - i);
+
+            start = time_usec();
+            for (int j = 0; j < n; j++) {
+                exprs[j] = expr_parse_string(s, &symtab, &addr_sets,
+                                             &port_groups, NULL, NULL, 0,
+                                             &error);
+            }
+            usec += time_usec() - start;
+
+            for (int j = 0; j < n; j++) {
+                expr_destroy(exprs[j]);
+            }
+        }
+        benchmark_report(s, "parse", n_iterations, usec);
+
+        benchmark_report(s, "annotate", n_iterations,
+                         benchmark_expr_stage(parsed, benchmark_annotate,
+                                              &aux, n_iterations));
+        benchmark_report(s, "simplify", n_iterations,
+                         benchmark_expr_stage(annotated, benchmark_simplify,
+                                              &aux, n_iterations));
+        benchmark_report(s, "normalize", n_iterations,
+                         benchmark_expr_stage(simplified, benchmark_normalize,
+                                              &aux, n_iterations));
+
+        usec = 0;
+        for (int i = 0; i < n_iterations; i += BENCHMARK_BATCH) {
+            struct hmap matches[BENCHMARK_BATCH];
+            int n = MIN(BENCHMARK_BATCH, n_iterations - i);
+
+            start = time_usec();
+            for (int j = 0; j < n; j++) {
+                expr_to_matches(normalized, lookup_port_cb, &ports,
+                                &matches[j]);
+            }
+            usec += time_usec() - start;
+
+            for (int j = 0; j < n; j++) {
+                expr_matches_destroy(&matches[j]);
+            }
+        }
+        benchmark_report(s, "to-matches", n_iterations, usec);
+
+        expr_destroy(parsed);
+        expr_destroy(annotated);
+        expr_destroy(simplified);
+        expr_destroy(normalized);
+    }
+    ds_destroy(&input);
+
+    simap_destroy(&ports);
+    expr_symtab_destroy(&symtab);
+    shash_destroy(&symtab);
+    expr_const_sets_destroy(&addr_sets);
+    shash_destroy(&addr_sets);
+    expr_const_sets_destroy(&port_groups);
+    shash_destroy(&port_groups);
+}
+
+static void
+test_benchmark_evaluate_expr(struct ovs_cmdl_context *ctx)
+{
+    struct shash symtab;
+    struct ds input;
+
+    ovn_init_symtab(&symtab);
+
+    struct flow uflow;
+    char *error = expr_parse_microflow(ctx->argv[1], &symtab, NULL, NULL,
+                                       lookup_atoi_cb, NULL, &uflow);
+    if (error) {
+        ovs_fatal(0, "%s", error);
+    }
+    int n_iterations = parse_benchmark_iterations(ctx->argv[2]);
+
+    ds_init(&input);
+    while (!ds_get_test_line(&input, stdin)) {
+        struct expr *expr;
+
+        expr = expr_parse_string(ds_cstr(&input), &symtab, NULL, NULL,
+                                 NULL, NULL, 0, &error);
+        if (!error) {
+            expr = expr_annotate(expr, &symtab, &error);
+        }
+        if (error) {
+            puts(error);
+            free(error);
+            expr_destroy(expr);
+            continue;
+        }
+        expr = expr_simplify(expr);
+
+        const char *s = ds_cstr(&input);
+        long long int start = time_usec();
+        int tree_matches = 0;
+        for (int i = 0; i < n_iterations; i++) {
+            tree_matches += expr_evaluate(expr, &uflow, lookup_atoi_cb, NULL);
+        }
+        benchmark_report(s, "evaluate-tree", n_iterations,
+                         time_usec() - start);
+
+        struct expr_program *prog = expr_program_compile(expr);
+        start = time_usec();
+        int prog_matches = 0;
+        for (int i = 0; i < n_iterations; i++) {
+            prog_matches += expr_program_evaluate(prog, &uflow,
+                                                  lookup_atoi_cb, NULL);
+        }
+        struct json *record = benchmark_record(s, "evaluate-program",
+                                               n_iterations,
+                                               time_usec() - start);
+        json_object_put(record, "comparisons",
+                        json_integer_create(expr_program_size(prog)));
+        benchmark_print(record);
+        ovs_assert(tree_matches == prog_matches);
+
+        expr_program_destroy(prog);
+        expr_destroy(expr);
+    }
+    ds_destroy(&input);
+
+    expr_symtab_destroy(&symtab);
+    shash_destroy(&symtab);
+}
 
 /* Compositions.
  *
@@ -940,6 +1277,7 @@ test_tree_shape_exhaustively(struct expr *expr, struct shash *symtab,
                 ovs_assert(expr_is_normalized(modified));
             }
         }
+        struct expr_program *prog = expr_program_compile(modified);
 
         struct hmap matches;
         struct classifier cls;
@@ -969,6 +1307,8 @@ test_tree_shape_exhaustively(struct expr *expr, struct shash *symtab,
 
             bool expected = expr_evaluate(expr, &f, lookup_atoi_cb, NULL);
             bool actual = expr_evaluate(modified, &f, lookup_atoi_cb, NULL);
+            ovs_assert(expr_program_evaluate(prog, &f, lookup_atoi_cb, NULL)
+                       == actual);
             if (actual != expected) {
                 struct ds expr_s, modified_s;
 
@@ -1046,6 +1386,7 @@ test_tree_shape_exhaustively(struct expr *expr, struct shash *symtab,
 
             expr_matches_destroy(&matches);
         }
+        expr_program_destroy(prog);
         expr_destroy(modified);
     }
 }
@@ -1256,6 +1597,39 @@ test_expr_to_packets(struct ovs_cmdl_context *ctx OVS_UNUSED)
     expr_symtab_destroy(&symtab);
     shash_destroy(&symtab);
 }
+
+static void
+test_aggregate_cidrs(struct ovs_cmdl_context *ctx OVS_UNUSED)
+{
+    struct ds input;
+
+    ds_init(&input);
+    while (!ds_get_test_line(&input, stdin)) {
+        struct svec values = SVEC_EMPTY_INITIALIZER;
+        char *save_ptr = NULL;
+        for (char *token = strtok_r(ds_cstr(&input), " ,", &save_ptr); token;
+             token = strtok_r(NULL, " ,", &save_ptr)) {
+            svec_add(&values, token);
+        }
+
+        struct expr_constant_set *cs = expr_constant_set_create_integers(
+            (const char *const *) values.names, values.n);
+        struct expr_constant_set *aggregated
+            = expr_constant_set_aggregate_cidrs(cs);
+
+        struct ds output = DS_EMPTY_INITIALIZER;
+        expr_constant_set_format(aggregated, &output);
+        puts(ds_cstr(&output));
+        ds_destroy(&output);
+
+        expr_constant_set_destroy(aggregated);
+        free(aggregated);
+        expr_constant_set_destroy(cs);
+        free(cs);
+        svec_destroy(&values);
+    }
+    ds_destroy(&input);
+}
 
 /* Actions. */
 
@@ -1318,6 +1692,9 @@ test_parse_actions(struct ovs_cmdl_context *ctx OVS_UNUSED)
     simap_put(&ports, "LOCAL", ofp_to_u16(OFPP_LOCAL));
     simap_put(&ports, "lsp1", 0x11);
 
+    struct ovnacts_encode_cache encode_cache;
+    ovnacts_encode_cache_init(&encode_cache, SIZE_MAX);
+
     ds_init(&input);
     while (!ds_get_test_line(&input, stdin)) {
         struct ofpbuf ovnacts;
@@ -1389,6 +1766,23 @@ test_parse_actions(struct ovs_cmdl_context *ctx OVS_UNUSED)
             char *ofpacts_cstr = ds_cstr(&ofpacts_s);
             printf("    encodes as %s\n", ofpacts_cstr);
             print_group_info(&group_table, ofpacts_cstr);
+
+            /* Check that encoding through the cache, both when it misses and
+             * when it hits, yields the same ofpacts. */
+            for (int i = 0; i < 2; i++) {
+                struct ofpbuf cached;
+                ofpbuf_init(&cached, 0);
+                ovnacts_encode_cached(&encode_cache, ds_cstr(&input),
+                                      pp.cur_ltable, ovnacts.data,
+                                      ovnacts.size, &ep, &cached);
+                if (!ofpacts_equal(ofpacts.data, ofpacts.size,
+                                   cached.data, cached.size)) {
+                    printf("    bad cached encoding\n");
+                    ok = false;
+                }
+                ofpbuf_uninit(&cached);
+            }
+
             ds_destroy(&ofpacts_s);
             ofpbuf_uninit(&ofpacts);
 
@@ -1437,6 +1831,7 @@ test_parse_actions(struct ovs_cmdl_context *ctx OVS_UNUSED)
     }
     ds_destroy(&input);
 
+    ovnacts_encode_cache_destroy(&encode_cache);
     simap_destroy(&ports);
     expr_symtab_destroy(&symtab);
     shash_destroy(&symtab);
@@ -1451,6 +1846,148 @@ test_parse_actions(struct ovs_cmdl_context *ctx OVS_UNUSED)
     exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
+static void
+test_benchmark_actions(struct ovs_cmdl_context *ctx)
+{
+    int n_iterations = parse_benchmark_iterations(ctx->argv[1]);
+
+    struct shash symtab;
+    struct hmap dhcp_opts;
+    struct hmap dhcpv6_opts;
+    struct hmap nd_ra_opts;
+    struct controller_event_options event_opts;
+    struct simap ports;
+
+    ovn_init_symtab(&symtab);
+    create_gen_opts(&dhcp_opts, &dhcpv6_opts, &nd_ra_opts, &event_opts);
+
+    struct ovn_extend_table group_table;
+    ovn_extend_table_init(&group_table, "group-table", OFPG_MAX);
+    struct ovn_extend_table meter_table;
+    ovn_extend_table_init(&meter_table, "meter-table", OFPM13_MAX);
+
+    simap_init(&ports);
+    simap_put(&ports, "lsp1", 0x11);
+    simap_put(&ports, "lsp2", 0x12);
+    simap_put(&ports, "lsp3", 0x13);
+
+    const struct ovnact_parse_params pp = {
+        .symtab = &symtab,
+        .dhcp_opts = &dhcp_opts,
+        .dhcpv6_opts = &dhcpv6_opts,
+        .nd_ra_opts = &nd_ra_opts,
+        .controller_event_opts = &event_opts,
+        .pipeline = OVNACT_P_INGRESS,
+        .n_tables = LOG_PIPELINE_LEN,
+        .cur_ltable = 10,
+    };
+    const struct ovnact_encode_params ep = {
+        .lookup_port = lookup_port_cb,
+        .tunnel_ofport = lookup_tunnel_ofport,
+        .aux = &ports,
+        .is_switch = true,
+        .group_table = &group_table,
+        .meter_table = &meter_table,
+
+        .pipeline = OVNACT_P_INGRESS,
+        .ingress_ptable = OFTABLE_LOG_INGRESS_PIPELINE,
+        .egress_ptable = OFTABLE_LOG_EGRESS_PIPELINE,
+        .output_ptable = OFTABLE_OUTPUT_INIT,
+        .mac_bind_ptable = OFTABLE_MAC_BINDING,
+        .mac_lookup_ptable = OFTABLE_MAC_LOOKUP,
+        .lb_hairpin_ptable = OFTABLE_CHK_LB_HAIRPIN,
+        .lb_hairpin_reply_ptable = OFTABLE_CHK_LB_HAIRPIN_REPLY,
+        .ct_snat_vip_ptable = OFTABLE_CT_SNAT_HAIRPIN,
+        .fdb_ptable = OFTABLE_GET_FDB,
+        .fdb_lookup_ptable = OFTABLE_LOOKUP_FDB,
+        .common_nat_ct_zone = MFF_LOG_DNAT_ZONE,
+        .in_port_sec_ptable = OFTABLE_CHK_IN_PORT_SEC,
+        .out_port_sec_ptable = OFTABLE_CHK_OUT_PORT_SEC,
+        .mac_cache_use_table = OFTABLE_MAC_CACHE_USE,
+    };
+
+    struct ovnacts_encode_cache encode_cache;
+    ovnacts_encode_cache_init(&encode_cache, SIZE_MAX);
+
+    struct ds input;
+    ds_init(&input);
+    while (!ds_get_test_line(&input, stdin)) {
+        const char *s = ds_cstr(&input);
+        struct ofpbuf ovnacts;
+        struct expr *prereqs;
+
+        ofpbuf_init(&ovnacts, 0);
+        char *error = ovnacts_parse_string(s, &pp, &ovnacts, &prereqs);
+        if (error) {
+            puts(error);
+            free(error);
+            expr_destroy(prereqs);
+            ovnacts_free(ovnacts.data, ovnacts.size);
+            ofpbuf_uninit(&ovnacts);
+            continue;
+        }
+
+        long long int usec = 0;
+        for (int i = 0; i < n_iterations; i += BENCHMARK_BATCH) {
+            struct ofpbuf parsed[BENCHMARK_BATCH];
+            struct expr *parsed_prereqs[BENCHMARK_BATCH];
+            int n = MIN(BENCHMARK_BATCH, n_iterations - i);
+
+            long long int start = time_usec();
+            for (int j = 0; j < n; j++) {
+                ofpbuf_init(&parsed[j], 0);
+                error = ovnacts_parse_string(s, &pp, &parsed[j],
+                                             &parsed_prereqs[j]);
+                free(error);
+            }
+            usec += time_usec() - start;
+
+            for (int j = 0; j < n; j++) {
+                expr_destroy(parsed_prereqs[j]);
+                ovnacts_free(parsed[j].data, parsed[j].size);
+                ofpbuf_uninit(&parsed[j]);
+            }
+        }
+        benchmark_report(s, "parse-actions", n_iterations, usec);
+
+        uint64_t ofpacts_stub[1024 / 8];
+        struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
+        long long int start = time_usec();
+        for (int i = 0; i < n_iterations; i++) {
+            ofpbuf_clear(&ofpacts);
+            ovnacts_encode(ovnacts.data, ovnacts.size, &ep, &ofpacts);
+        }
+        benchmark_report(s, "encode-actions", n_iterations,
+                         time_usec() - start);
+
+        start = time_usec();
+        for (int i = 0; i < n_iterations; i++) {
+            ofpbuf_clear(&ofpacts);
+            ovnacts_encode_cached(&encode_cache, s, pp.cur_ltable,
+                                  ovnacts.data, ovnacts.size, &ep, &ofpacts);
+        }
+        benchmark_report(s, "encode-actions-cached", n_iterations,
+                         time_usec() - start);
+        ofpbuf_uninit(&ofpacts);
+
+        expr_destroy(prereqs);
+        ovnacts_free(ovnacts.data, ovnacts.size);
+        ofpbuf_uninit(&ovnacts);
+    }
+    ds_destroy(&input);
+
+    ovnacts_encode_cache_destroy(&encode_cache);
+    simap_destroy(&ports);
+    expr_symtab_destroy(&symtab);
+    shash_destroy(&symtab);
+    dhcp_opts_destroy(&dhcp_opts);
+    dhcp_opts_destroy(&dhcpv6_opts);
+    nd_ra_opts_destroy(&nd_ra_opts);
+    controller_event_opts_destroy(&event_opts);
+    ovn_extend_table_destroy(&group_table);
+    ovn_extend_table_destroy(&meter_table);
+}
+
 static unsigned int
 parse_relops(const char *s)
 {
@@ -1499,6 +2036,11 @@ expr-to-packets\n\
   Parses OVN expressions from stdin and prints out matching packets in\n\
   hexadecimal on stdout.\n\
 \n\
+aggregate-cidrs\n\
+  Reads address sets from stdin, one per line as a list of values separated\n\
+  by spaces or commas, and prints each of them on stdout with its IPv4\n\
+  and IPv6 addresses aggregated into CIDR prefixes.\n\
+\n\
 evaluate-expr MICROFLOW\n\
   Parses OVN expressions from stdin and evaluates them against the flow\n\
   specified in MICROFLOW, which must be an expression that constrains\n\
@@ -1510,6 +2052,19 @@ evaluate-expr MICROFLOW\n\
   evaluates to true, \"udp\" evaluates to false, and \"udp || tcp\"\n\
   evaluates to true.\n\
 \n\
+benchmark-expr N [ADDR_SET_SIZE]\n\
+  Runs each stage of processing OVN expressions from stdin N times: lex,\n\
+  parse, annotate, simplify, normalize, and conversion to matches.  The\n\
+  address set $big has ADDR_SET_SIZE addresses (default 10000).  Prints\n\
+  the time taken by each stage and its rate on stdout, one JSON object\n\
+  per line.\n\
+\n\
+benchmark-evaluate-expr MICROFLOW N\n\
+  Parses OVN expressions from stdin and evaluates each of them N times\n\
+  against MICROFLOW, both as an expression tree and as a compiled program,\n\
+  and prints the results like benchmark-expr.  The result for the compiled\n\
+  program also gives its number of comparisons.\n\
+\n\
 composition N\n\
   Prints all the compositions of N on stdout.\n\
 \n\
@@ -1536,6 +2091,11 @@ exhaustive N\n\
 parse-actions\n\
   Parses OVN actions from stdin and prints the equivalent OpenFlow actions\n\
   on stdout.\n\
+\n\
+benchmark-actions N\n\
+  Parses OVN actions from stdin N times, then encodes them N times both\n\
+  directly and through an encode cache, and prints the results like\n\
+  benchmark-expr.\n\
 ",
            program_name, program_name);
     exit(EXIT_SUCCESS);
@@ -1653,13 +2213,18 @@ test_ovn_main(int argc, char *argv[])
         {"normalize-expr", NULL, 0, 0, test_normalize_expr, OVS_RO},
         {"expr-to-flows", NULL, 0, 0, test_expr_to_flows, OVS_RO},
         {"evaluate-expr", NULL, 1, 1, test_evaluate_expr, OVS_RO},
+        {"benchmark-expr", NULL, 1, 2, test_benchmark_expr, OVS_RO},
+        {"benchmark-evaluate-expr", NULL, 2, 2, test_benchmark_evaluate_expr,
+         OVS_RO},
         {"composition", NULL, 1, 1, test_composition, OVS_RO},
         {"tree-shape", NULL, 1, 1, test_tree_shape, OVS_RO},
         {"exhaustive", NULL, 1, 1, test_exhaustive, OVS_RO},
         {"expr-to-packets", NULL, 0, 0, test_expr_to_packets, OVS_RO},
+        {"aggregate-cidrs", NULL, 0, 0, test_aggregate_cidrs, OVS_RO},
 
         /* Actions. */
         {"parse-actions", NULL, 0, 0, test_parse_actions, OVS_RO},
+        {"benchmark-actions", NULL, 1, 1, test_benchmark_actions, OVS_RO},
 
         {NULL, NULL, 0, 0, NULL, OVS_RO},
     };
@@ -24,6 +24,7 @@
 #include "dirs.h"
 #include "fatal-signal.h"
 #include "flow.h"
+#include "hash.h"
 #include "nx-match.h"
 #include "openvswitch/dynamic-string.h"
 #include "openvswitch/json.h"
@@ -143,7 +144,6 @@ main(int argc, char *argv[])
     ovnsb_idl = ovsdb_idl_create(db, &sbrec_idl_class, true, false);
     ovsdb_idl_set_leader_only(ovnsb_idl, leader_only);
 
-    bool already_read = false;
     for (;;) {
         ovsdb_idl_run(ovnsb_idl);
         unixctl_server_run(server);
@@ -154,13 +154,10 @@ main(int argc, char *argv[])
         }
 
         if (ovsdb_idl_has_ever_connected(ovnsb_idl)) {
-            if (!already_read) {
-                already_read = true;
-                read_db();
-            }
-
             daemonize_complete();
             if (!get_detach()) {
+                refresh_db();
+
                 const char *dp_s = argc > 1 ? argv[0] : NULL;
                 const char *flow_s = argv[argc - 1];
                 char *output = trace(dp_s, flow_s);
@@ -429,9 +426,22 @@ struct ovntrace_datapath {
 
     struct ovs_list mcgroups;   /* Contains "struct ovntrace_mcgroup"s. */
 
+    /* Logical flows are parsed only when a trace first enters the datapath.
+     * Until then, 'sb_flows' refers to the datapath's southbound records,
+     * which stay valid because refresh_db() re-reads the database whenever
+     * the IDL changes. */
+    const struct sbrec_logical_flow **sb_flows;
+    size_t n_sb_flows, allocated_sb_flows;
+    bool flows_parsed;
+
     struct ovntrace_flow **flows;
     size_t n_flows, allocated_flows;
 
+    /* Index into 'flows' for each logical table, by 'enum ovnact_pipeline'
+     * and then by table ID. */
+    struct ovntrace_table *tables[2];
+    size_t n_tables[2];
+
     struct hmap mac_bindings;   /* Contains "struct ovntrace_mac_binding"s. */
     struct hmap fdbs;   /* Contains "struct ovntrace_fdb"s. */
 
@@ -473,10 +483,35 @@ struct ovntrace_flow {
     int priority;
     char *match_s;
     struct expr *match;
+    struct expr_program *match_prog; /* 'match' compiled for lookups. */
     struct ovnact *ovnacts;
     size_t ovnacts_len;
 };
 
+/* The flows in one logical table of a datapath.
+ *
+ * When many of the flows in the table require a particular value of a single
+ * field, e.g. "inport", the table is also indexed on that field, so that a
+ * lookup only needs to consider the flows that require the field's value in
+ * the packet plus those that do not constrain the field at all. */
+struct ovntrace_table {
+    struct ovntrace_flow **flows; /* Points into ovntrace_datapath's flows. */
+    size_t n_flows;
+
+    const struct mf_field *key_field; /* NULL if the table is not indexed. */
+    struct hmap buckets;        /* Contains "struct ovntrace_flow_bucket"s. */
+    size_t *wildcards;          /* Flows not constrained on 'key_field'. */
+    size_t n_wildcards;
+};
+
+/* The flows in an ovntrace_table that require 'key_field' to be 'key'. */
+struct ovntrace_flow_bucket {
+    struct hmap_node node;      /* In ovntrace_table's 'buckets'. */
+    union mf_value key;         /* First 'key_field->n_bytes' significant. */
+    size_t *flows;              /* Indexes into table's 'flows', ascending. */
+    size_t n_flows, allocated_flows;
+};
+
 struct ovntrace_mac_binding {
     struct hmap_node node;
     uint16_t port_key;
@@ -962,15 +997,8 @@ ovntrace_make_names_friendly(const char *in)
 
 static void
 parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
-                        const struct sbrec_datapath_binding *sbdb)
+                         struct ovntrace_datapath *dp)
 {
-        struct ovntrace_datapath *dp
-            = ovntrace_datapath_find_by_sb_uuid(&sbdb->header_.uuid);
-        if (!dp) {
-            VLOG_WARN("logical flow missing datapath");
-            return;
-        }
-
         char *error;
         struct expr *match;
         struct lex_str match_s = lexer_parse_template_string(sblf->match,
@@ -1045,6 +1073,7 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
         flow->priority = sblf->priority;
         flow->match_s = ovntrace_make_names_friendly(sblf->match);
         flow->match = match;
+        flow->match_prog = expr_program_compile(match);
         flow->ovnacts_len = ovnacts.size;
         flow->ovnacts = ofpbuf_steal_data(&ovnacts);
 
@@ -1055,6 +1084,24 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
         dp->flows[dp->n_flows++] = flow;
 }
 
+static void
+add_lflow_to_datapath(const struct sbrec_logical_flow *sblf,
+                      const struct sbrec_datapath_binding *sbdb)
+{
+    struct ovntrace_datapath *dp
+        = ovntrace_datapath_find_by_sb_uuid(&sbdb->header_.uuid);
+    if (!dp) {
+        VLOG_WARN("logical flow missing datapath");
+        return;
+    }
+
+    if (dp->n_sb_flows >= dp->allocated_sb_flows) {
+        dp->sb_flows = x2nrealloc(dp->sb_flows, &dp->allocated_sb_flows,
+                                  sizeof *dp->sb_flows);
+    }
+    dp->sb_flows[dp->n_sb_flows++] = sblf;
+}
+
 static void
 read_flows(void)
 {
@@ -1065,24 +1112,42 @@ read_flows(void)
         bool missing_datapath = true;
 
         if (sblf->logical_datapath) {
-            parse_lflow_for_datapath(sblf, sblf->logical_datapath);
+            add_lflow_to_datapath(sblf, sblf->logical_datapath);
             missing_datapath = false;
         }
 
         const struct sbrec_logical_dp_group *g = sblf->logical_dp_group;
         for (size_t i = 0; g && i < g->n_datapaths; i++) {
-            parse_lflow_for_datapath(sblf, g->datapaths[i]);
+            add_lflow_to_datapath(sblf, g->datapaths[i]);
             missing_datapath = false;
         }
         if (missing_datapath) {
             VLOG_WARN("logical flow missing datapath");
         }
     }
+}
 
-    const struct ovntrace_datapath *dp;
-    HMAP_FOR_EACH (dp, sb_uuid_node, &datapaths) {
-        qsort(dp->flows, dp->n_flows, sizeof *dp->flows, compare_flow);
+static void ovntrace_datapath_index_flows(struct ovntrace_datapath *);
+
+/* Parses and indexes the logical flows in 'dp', if that has not been done
+ * yet. */
+static void
+ovntrace_datapath_parse_flows(struct ovntrace_datapath *dp)
+{
+    if (dp->flows_parsed) {
+        return;
+    }
+    dp->flows_parsed = true;
+
+    for (size_t i = 0; i < dp->n_sb_flows; i++) {
+        parse_lflow_for_datapath(dp->sb_flows[i], dp);
     }
+    free(dp->sb_flows);
+    dp->sb_flows = NULL;
+    dp->n_sb_flows = dp->allocated_sb_flows = 0;
+
+    qsort(dp->flows, dp->n_flows, sizeof *dp->flows, compare_flow);
+    ovntrace_datapath_index_flows(dp);
 }
 
 static void
@@ -1184,6 +1249,141 @@ read_db(void)
     read_fdbs();
 }
 
+static void
+ovntrace_flow_destroy(struct ovntrace_flow *flow)
+{
+    free(flow->stage_name);
+    free(flow->source);
+    free(flow->match_s);
+    expr_destroy(flow->match);
+    expr_program_destroy(flow->match_prog);
+    ovnacts_free(flow->ovnacts, flow->ovnacts_len);
+    free(flow->ovnacts);
+    free(flow);
+}
+
+static void
+ovntrace_table_destroy(struct ovntrace_table *table)
+{
+    if (table->key_field) {
+        struct ovntrace_flow_bucket *bucket;
+        HMAP_FOR_EACH_POP (bucket, node, &table->buckets) {
+            free(bucket->flows);
+            free(bucket);
+        }
+        hmap_destroy(&table->buckets);
+        free(table->wildcards);
+    }
+}
+
+static void
+ovntrace_datapath_destroy(struct ovntrace_datapath *dp)
+{
+    struct ovntrace_mcgroup *mcgroup;
+    LIST_FOR_EACH_POP (mcgroup, list_node, &dp->mcgroups) {
+        free(mcgroup->name);
+        free(mcgroup->ports);
+        free(mcgroup);
+    }
+
+    for (size_t p = 0; p < ARRAY_SIZE(dp->tables); p++) {
+        for (size_t i = 0; i < dp->n_tables[p]; i++) {
+            ovntrace_table_destroy(&dp->tables[p][i]);
+        }
+        free(dp->tables[p]);
+    }
+    for (size_t i = 0; i < dp->n_flows; i++) {
+        ovntrace_flow_destroy(dp->flows[i]);
+    }
+    free(dp->flows);
+    free(dp->sb_flows);
+
+    struct ovntrace_mac_binding *binding;
+    HMAP_FOR_EACH_POP (binding, node, &dp->mac_bindings) {
+        free(binding);
+    }
+    hmap_destroy(&dp->mac_bindings);
+
+    struct ovntrace_fdb *fdb;
+    HMAP_FOR_EACH_POP (fdb, node, &dp->fdbs) {
+        free(fdb);
+    }
+    hmap_destroy(&dp->fdbs);
+
+    free(dp->name);
+    free(dp->name2);
+    free(dp->friendly_name);
+    free(dp);
+}
+
+static void
+ovntrace_port_destroy(struct ovntrace_port *port)
+{
+    free(port->name);
+    free(port->name2);
+    free(CONST_CAST(char *, port->friendly_name));
+    free(port->type);
+    for (size_t i = 0; i < port->n_ps_addrs; i++) {
+        destroy_lport_addresses(&port->ps_addrs[i]);
+    }
+    free(port->ps_addrs);
+    free(port);
+}
+
+/* Frees everything that read_db() read. */
+static void
+free_db(void)
+{
+    struct ovntrace_datapath *dp;
+    HMAP_FOR_EACH_POP (dp, sb_uuid_node, &datapaths) {
+        ovntrace_datapath_destroy(dp);
+    }
+    hmap_destroy(&datapaths);
+
+    struct shash_node *node;
+    SHASH_FOR_EACH (node, &ports) {
+        ovntrace_port_destroy(node->data);
+    }
+    shash_destroy(&ports);
+
+    expr_const_sets_destroy(&address_sets);
+    shash_destroy(&address_sets);
+    expr_const_sets_destroy(&port_groups);
+    shash_destroy(&port_groups);
+
+    dhcp_opts_destroy(&dhcp_opts);
+    dhcp_opts_destroy(&dhcpv6_opts);
+    nd_ra_opts_destroy(&nd_ra_opts);
+    controller_event_opts_destroy(&event_opts);
+    smap_destroy(&template_vars);
+
+    expr_symtab_destroy(&symtab);
+    shash_destroy(&symtab);
+}
+
+/* Whether read_db() has been called and, if so, the IDL sequence number of
+ * the database contents that it read. */
+static bool db_read;
+static unsigned int db_seqno;
+
+/* Brings the data read from the database up to date with the IDL.  This only
+ * happens just before tracing, so that any number of database changes
+ * between two traces cost a single reload. */
+static void
+refresh_db(void)
+{
+    unsigned int seqno = ovsdb_idl_get_seqno(ovnsb_idl);
+    if (!db_read || seqno != db_seqno) {
+        if (db_read) {
+            VLOG_DBG("reloading southbound database");
+            free_db();
+        }
+        read_db();
+        db_read = true;
+        db_seqno = seqno;
+    }
+}
+
 static const struct ovntrace_port *
 ovntrace_port_lookup_by_name(const char *name)
 {
@@ -1228,11 +1428,9 @@ ovntrace_port_lookup_by_name(const char *name)
 }
 
 static bool
-ovntrace_lookup_port(const void *dp_, const char *port_name,
-                     unsigned int *portp)
+ovntrace_lookup_port__(const struct ovntrace_datapath *dp,
+                       const char *port_name, unsigned int *portp, bool warn)
 {
-    const struct ovntrace_datapath *dp = dp_;
-
     if (port_name[0] == '\0') {
         *portp = 0;
         return true;
@@ -1260,21 +1458,251 @@ ovntrace_lookup_port(const void *dp_, const char *port_name,
         return true;
     }
 
-    VLOG_WARN("%s: unknown logical port", port_name);
+    if (warn) {
+        VLOG_WARN("%s: unknown logical port", port_name);
+    }
     return false;
 }
 
+static bool
+ovntrace_lookup_port(const void *dp_, const char *port_name,
+                     unsigned int *portp)
+{
+    return ovntrace_lookup_port__(dp_, port_name, portp, true);
+}
+
+/* If comparison 'cmp' can only be true when its field has one particular
+ * value, stores that value into 'value' and returns true.  Otherwise returns
+ * false. */
+static bool
+ovntrace_get_cmp_key(const struct ovntrace_datapath *dp,
+                     const struct expr *cmp, union mf_value *value)
+{
+    const struct expr_symbol *symbol = cmp->cmp.symbol;
+    const struct mf_field *field = symbol->field;
+
+    if (cmp->cmp.relop != EXPR_R_EQ) {
+        return false;
+    }
+
+    memset(value, 0, sizeof *value);
+    if (symbol->width) {
+        int n_bytes = field->n_bytes;
+        const uint8_t *mask = &cmp->cmp.mask.u8[sizeof cmp->cmp.mask
+                                                - n_bytes];
+        if (field->n_bits != n_bytes * 8 || !is_all_ones(mask, n_bytes)) {
+            return false;
+        }
+        memcpy(value, &cmp->cmp.value.u8[sizeof cmp->cmp.value - n_bytes],
+               n_bytes);
+    } else {
+        /* String fields are logical port registers.  A port name that does
+         * not resolve never matches, so leaving such a flow unindexed is
+         * harmless. */
+        unsigned int port;
+        if (field->n_bytes != sizeof(ovs_be32)
+            || !ovntrace_lookup_port__(dp, cmp->cmp.string, &port, false)) {
+            return false;
+        }
+        value->be32 = htonl(port);
+    }
+    return true;
+}
+
+/* Returns the top-level comparison in 'match' that ovntrace_get_cmp_key()
+ * accepts for 'field', or NULL if there is none.  If 'field' is NULL, any
+ * field is acceptable and the first such comparison is returned. */
+static const struct expr *
+ovntrace_find_cmp_key(const struct ovntrace_datapath *dp,
+                      const struct expr *match, const struct mf_field *field,
+                      union mf_value *value)
+{
+    if (match->type == EXPR_T_CMP) {
+        return ((!field || match->cmp.symbol->field == field)
+                && ovntrace_get_cmp_key(dp, match, value)
+                ? match : NULL);
+    } else if (match->type == EXPR_T_AND) {
+        const struct expr *sub;
+        LIST_FOR_EACH (sub, node, &match->andor) {
+            if (sub->type == EXPR_T_CMP
+                && (!field || sub->cmp.symbol->field == field)
+                && ovntrace_get_cmp_key(dp, sub, value)) {
+                return sub;
+            }
+        }
+    }
+    return NULL;
+}
+
+static struct ovntrace_flow_bucket *
+ovntrace_flow_bucket_find(const struct ovntrace_table *table,
+                          const union mf_value *key, uint32_t hash)
+{
+    struct ovntrace_flow_bucket *bucket;
+    HMAP_FOR_EACH_WITH_HASH (bucket, node, hash, &table->buckets) {
+        if (!memcmp(&bucket->key, key, table->key_field->n_bytes)) {
+            return bucket;
+        }
+    }
+    return NULL;
+}
+
+static void
+ovntrace_table_index(const struct ovntrace_datapath *dp,
+                     struct ovntrace_table *table)
+{
+    hmap_init(&table->buckets);
+    table->key_field = NULL;
+    table->wildcards = NULL;
+    table->n_wildcards = 0;
+
+    /* Pick the field on which the most flows in the table require a single
+     * value.  Only consider the first such comparison in each flow, which is
+     * enough to find "inport" and "outport" in the stages that use them. */
+    size_t *counts = xcalloc(MFF_N_IDS, sizeof *counts);
+    size_t best_n = 0;
+    for (size_t i = 0; i < table->n_flows; i++) {
+        union mf_value value;
+        const struct expr *cmp = ovntrace_find_cmp_key(
+            dp, table->flows[i]->match, NULL, &value);
+        if (!cmp) {
+            continue;
+        }
+
+        const struct mf_field *field = cmp->cmp.symbol->field;
+        if (++counts[field->id] > best_n) {
+            best_n = counts[field->id];
+            table->key_field = field;
+        }
+    }
+    free(counts);
+
+    /* With fewer than two keyed flows, the index cannot exclude anything
+     * that a linear scan would not skip just as quickly. */
+    if (best_n < 2) {
+        table->key_field = NULL;
+        return;
+    }
+
+    table->wildcards = xmalloc(table->n_flows * sizeof *table->wildcards);
+    for (size_t i = 0; i < table->n_flows; i++) {
+        union mf_value value;
+        if (!ovntrace_find_cmp_key(dp, table->flows[i]->match,
+                                   table->key_field, &value)) {
+            table->wildcards[table->n_wildcards++] = i;
+            continue;
+        }
+
+        uint32_t hash = hash_bytes(&value, table->key_field->n_bytes, 0);
+        struct ovntrace_flow_bucket *bucket
+            = ovntrace_flow_bucket_find(table, &value, hash);
+        if (!bucket) {
+            bucket = xzalloc(sizeof *bucket);
+            bucket->key = value;
+            hmap_insert(&table->buckets, &bucket->node, hash);
+        }
+        if (bucket->n_flows >= bucket->allocated_flows) {
+            bucket->flows = x2nrealloc(bucket->flows,
+                                       &bucket->allocated_flows,
+                                       sizeof *bucket->flows);
+        }
+        bucket->flows[bucket->n_flows++] = i;
+    }
+}
+
+/* Divides 'dp''s flows, which must already be sorted with compare_flow(),
+ * into logical tables and indexes each of them. */
+static void
+ovntrace_datapath_index_flows(struct ovntrace_datapath *dp)
+{
+    for (size_t i = 0; i < dp->n_flows; ) {
+        const struct ovntrace_flow *flow = dp->flows[i];
+        size_t n = 1;
+        while (i + n < dp->n_flows
+               && dp->flows[i + n]->pipeline == flow->pipeline
+               && dp->flows[i + n]->table_id == flow->table_id) {
+            n++;
+        }
+
+        enum ovnact_pipeline p = flow->pipeline;
+        if (flow->table_id >= dp->n_tables[p]) {
+            size_t n_tables = flow->table_id + 1;
+            dp->tables[p] = xrealloc(dp->tables[p],
+                                     n_tables * sizeof *dp->tables[p]);
+            memset(&dp->tables[p][dp->n_tables[p]], 0,
+                   (n_tables - dp->n_tables[p]) * sizeof *dp->tables[p]);
+            dp->n_tables[p] = n_tables;
+        }
+
+        struct ovntrace_table *table = &dp->tables[p][flow->table_id];
+        table->flows = &dp->flows[i];
+        table->n_flows = n;
+        ovntrace_table_index(dp, table);
+
+        i += n;
+    }
+}
+
+static const struct ovntrace_table *
+ovntrace_table_get(const struct ovntrace_datapath *dp,
+                   uint8_t table_id, enum ovnact_pipeline pipeline)
+{
+    /* Parsing only fills in a cache, so it is fine on a const datapath. */
+    ovntrace_datapath_parse_flows(CONST_CAST(struct ovntrace_datapath *, dp));
+
+    return (table_id < dp->n_tables[pipeline]
+            ? &dp->tables[pipeline][table_id]
+            : NULL);
+}
+
+static bool
+ovntrace_table_match(const struct ovntrace_datapath *dp,
+                     const struct ovntrace_table *table, size_t idx,
+                     const struct flow *uflow)
+{
+    return expr_program_evaluate(table->flows[idx]->match_prog, uflow,
+                                 ovntrace_lookup_port, dp);
+}
+
 static const struct ovntrace_flow *
 ovntrace_flow_lookup(const struct ovntrace_datapath *dp,
                      const struct flow *uflow,
                      uint8_t table_id, enum ovnact_pipeline pipeline)
 {
-    for (size_t i = 0; i < dp->n_flows; i++) {
-        const struct ovntrace_flow *flow = dp->flows[i];
-        if (flow->pipeline == pipeline &&
-            flow->table_id == table_id &&
-            expr_evaluate(flow->match, uflow, ovntrace_lookup_port, dp)) {
-            return flow;
+    const struct ovntrace_table *table = ovntrace_table_get(dp, table_id,
+                                                            pipeline);
+    if (!table) {
+        return NULL;
+    }
+
+    if (!table->key_field) {
+        for (size_t i = 0; i < table->n_flows; i++) {
+            if (ovntrace_table_match(dp, table, i, uflow)) {
+                return table->flows[i];
+            }
+        }
+        return NULL;
+    }
+
+    union mf_value value;
+    memset(&value, 0, sizeof value);
+    mf_get_value(table->key_field, uflow, &value);
+    const struct ovntrace_flow_bucket *bucket = ovntrace_flow_bucket_find(
+        table, &value, hash_bytes(&value, table->key_field->n_bytes, 0));
+
+    /* Both lists are in priority order, so merge them. */
+    size_t n_bucket = bucket ? bucket->n_flows : 0;
+    size_t i = 0, j = 0;
+    while (i < n_bucket || j < table->n_wildcards) {
+        size_t idx;
+        if (j >= table->n_wildcards
+            || (i < n_bucket && bucket->flows[i] < table->wildcards[j])) {
+            idx = bucket->flows[i++];
+        } else {
+            idx = table->wildcards[j++];
+        }
+        if (ovntrace_table_match(dp, table, idx, uflow)) {
+            return table->flows[idx];
         }
     }
     return NULL;
@@ -1284,13 +1712,11 @@ static char *
 ovntrace_stage_name(const struct ovntrace_datapath *dp,
                     uint8_t table_id, enum ovnact_pipeline pipeline)
 {
-    for (size_t i = 0; i < dp->n_flows; i++) {
-        const struct ovntrace_flow *flow = dp->flows[i];
-        if (flow->pipeline == pipeline && flow->table_id == table_id) {
-            return xstrdup(flow->stage_name);;
-        }
-    }
-    return NULL;
+    const struct ovntrace_table *table = ovntrace_table_get(dp, table_id,
+                                                            pipeline);
+    return (table && table->n_flows
+            ? nullable_xstrdup(table->flows[0]->stage_name)
+            : NULL);
 }
 
 /* Type of a node within a trace. */
@@ -3729,6 +4155,12 @@ ovntrace_trace(struct unixctl_conn *conn, int argc,
         return;
     }
 
+    if (!ovsdb_idl_has_ever_connected(ovnsb_idl)) {
+        unixctl_command_reply_error(conn, "not yet connected to database");
+        return;
+    }
+    refresh_db();
+
     const char *dp_s = argc > 2 ? argv[1] : NULL;
     const char *flow_s = argv[argc - 1];
     char *output = trace(dp_s, flow_s);